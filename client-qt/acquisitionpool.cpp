@@ -0,0 +1,52 @@
+#include "acquisitionpool.h"
+#include <QDebug>
+
+AcquisitionPool::AcquisitionPool(int maxThreads, QObject *parent)
+    : QObject(parent)
+    , m_maxThreads(qMax(1, maxThreads))
+{}
+
+AcquisitionPool::~AcquisitionPool()
+{
+    for (const Worker &worker : std::as_const(m_workers)) {
+        worker.thread->quit();
+        worker.thread->wait();
+    }
+}
+
+int AcquisitionPool::defaultThreadCount()
+{
+    return qBound(1, QThread::idealThreadCount() / 2, 4);
+}
+
+QThread *AcquisitionPool::acquire()
+{
+    Worker *least = nullptr;
+    for (Worker &worker : m_workers) {
+        if (!least || worker.beds < least->beds)
+            least = &worker;
+    }
+
+    // Another thread only once every running one has a bed
+    if (!least || (least->beds > 0 && m_workers.size() < m_maxThreads)) {
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QString("BedAcquisition%1").arg(m_workers.size()));
+        thread->start(QThread::HighPriority);
+        m_workers.append({thread, 0});
+        least = &m_workers.last();
+        qDebug() << "Acquisition pool:" << m_workers.size() << "worker threads";
+    }
+
+    ++least->beds;
+    return least->thread;
+}
+
+void AcquisitionPool::release(QThread *thread)
+{
+    for (Worker &worker : m_workers) {
+        if (worker.thread == thread) {
+            worker.beds = qMax(0, worker.beds - 1);
+            return;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ACQUISITIONPOOL_H
+#define ACQUISITIONPOOL_H
+
+#include <QObject>
+#include <QThread>
+#include <QVector>
+
+// Worker threads shared by the acquisition of all beds.
+// Serial I/O is event driven, so one thread can serve several ports; beds
+// are spread over at most maxThreads threads, each new bed going to the
+// least loaded one. Threads are started on first use and stopped in the
+// destructor, after every bed has released its thread.
+class AcquisitionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AcquisitionPool(int maxThreads, QObject *parent = nullptr);
+    ~AcquisitionPool();
+
+    // Thread for a new bed, and handing it back when the bed goes away
+    QThread *acquire();
+    void release(QThread *thread);
+
+    int maxThreads() const { return m_maxThreads; }
+    int threadCount() const { return int(m_workers.size()); }
+
+    // Default size: half the cores, at least one and at most four threads
+    static int defaultThreadCount();
+
+private:
+    struct Worker
+    {
+        QThread *thread;
+        int beds;
+    };
+
+    int m_maxThreads;
+    QVector<Worker> m_workers;
+};
+
+#endif // ACQUISITIONPOOL_H
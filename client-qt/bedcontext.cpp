@@ -0,0 +1,124 @@
+#include "bedcontext.h"
+#include "database.h"
+#include <QDebug>
+
+BedContext::BedContext(const QString &bedId, const QString &portName, QThread *workerThread, QObject *parent)
+    : QObject(parent)
+    , m_bedId(bedId)
+    , m_portName(portName)
+    , m_workerThread(workerThread)
+{
+    // Same sizes as the primary device's buffers in DeviceManager
+    m_ecgBuffer = new WaveformBuffer(8192, this);
+    m_plethBuffer = new WaveformBuffer(2048, this);
+    m_respBuffer = new WaveformBuffer(2048, this);
+
+    m_device = new SMMProtocolTest();
+    m_device->setPortName(portName);
+    m_device->setQueuedDelivery(true);
+    m_device->setWaveformDelivery(false);
+    m_device->moveToThread(workerThread);
+
+    // Events are queued on the worker and applied here, on the UI thread;
+    // the samples of one drain reach each buffer as one batch
+    connect(m_device, &SMMProtocolTest::eventsPending, this, [this]() {
+        m_device->drainEvents();
+        appendWaveforms();
+    });
+
+    connect(m_device, &VitalSource::heartRateChanged, this, [this]() {
+        emit heartRateChanged();
+        storeMeasurement();
+    });
+    connect(m_device, &VitalSource::spo2Changed, this, [this]() {
+        emit spo2Changed();
+        storeMeasurement();
+    });
+    connect(m_device, &VitalSource::respirationRateChanged, this, &BedContext::respirationRateChanged);
+    connect(m_device, &VitalSource::monitoringChanged, this, &BedContext::monitoringChanged,
+            Qt::QueuedConnection);
+}
+
+BedContext::~BedContext()
+{
+    // Closes the port and the open waveform segments on the worker thread
+    QMetaObject::invokeMethod(m_device, &VitalSource::stopMonitoring, Qt::BlockingQueuedConnection);
+    disconnect(m_device, nullptr, this, nullptr);
+    m_device->deleteLater();
+}
+
+void BedContext::start()
+{
+    QMetaObject::invokeMethod(m_device, &VitalSource::startMonitoring);
+    qDebug() << "Bed" << m_bedId << "acquiring from" << m_portName;
+}
+
+void BedContext::stop()
+{
+    QMetaObject::invokeMethod(m_device, &VitalSource::stopMonitoring);
+}
+
+void BedContext::setPatientId(const QString &patientId)
+{
+    if (m_patientId == patientId)
+        return;
+
+    m_patientId = patientId;
+
+    // The waveform store belongs to the worker thread
+    QMetaObject::invokeMethod(m_device, [device = m_device, patientId]() {
+        device->setRecordingPatient(patientId);
+    });
+
+    emit patientIdChanged();
+}
+
+void BedContext::subscribe()
+{
+    if (m_subscribers++ > 0)
+        return;
+
+    // Samples from before the gap would be drawn next to the new ones
+    m_device->takeWaveformBatch(m_waveformBatch);
+    m_ecgBuffer->clear();
+    m_plethBuffer->clear();
+    m_respBuffer->clear();
+    m_device->setWaveformDelivery(true);
+    emit subscribedChanged();
+}
+
+void BedContext::unsubscribe()
+{
+    if (m_subscribers == 0 || --m_subscribers > 0)
+        return;
+
+    m_device->setWaveformDelivery(false);
+    emit subscribedChanged();
+}
+
+void BedContext::setEcgLead(int lead)
+{
+    // Read where the events are applied, which is this thread
+    m_device->setEcgLead(lead);
+}
+
+void BedContext::appendWaveforms()
+{
+    m_device->takeWaveformBatch(m_waveformBatch);
+
+    const QVector<quint8> &ecg = m_waveformBatch.samples[VitalSource::EcgWaveform];
+    const QVector<quint8> &pleth = m_waveformBatch.samples[VitalSource::PlethWaveform];
+    const QVector<quint8> &resp = m_waveformBatch.samples[VitalSource::RespWaveform];
+    m_ecgBuffer->append(ecg.constData(), int(ecg.size()));
+    m_plethBuffer->append(pleth.constData(), int(pleth.size()));
+    m_respBuffer->append(resp.constData(), int(resp.size()));
+}
+
+void BedContext::storeMeasurement()
+{
+    if (m_patientId.isEmpty())
+        return;
+
+    databaseClass::instance()->insertMeasurement(m_patientId, m_device->heartRateValue(),
+                                                 m_device->spo2Value(), m_device->respirationRate());
+}
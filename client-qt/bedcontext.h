@@ -0,0 +1,105 @@
+#ifndef BEDCONTEXT_H
+#define BEDCONTEXT_H
+
+#include <QObject>
+#include <QPointer>
+#include <QThread>
+#include "smmprotocoltest.h"
+#include "waveformbuffer.h"
+
+// Acquisition state of one bed in a multi-bed deployment: its serial
+// monitor, the patient bound to it and its waveform buffers.
+//
+// The SMMProtocolTest of a bed lives on a worker thread of the
+// AcquisitionPool and runs in queued-delivery mode; this object lives on the
+// UI thread, applies the decoded events and owns the buffers QML renders
+// from. Vitals are stored for the bound patient whether or not anyone
+// watches the bed. Waveforms only reach the buffers while the bed has
+// subscribers (see subscribe()); the worker stops queueing them otherwise,
+// so unwatched beds cost no UI-thread time per sample. The samples applied
+// by one drain are appended to each buffer in one call. Raw waveforms are
+// always recorded for the bound patient.
+class BedContext : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString bedId READ bedId CONSTANT)
+    Q_PROPERTY(QString portName READ portName CONSTANT)
+    Q_PROPERTY(QString patientId READ patientId WRITE setPatientId NOTIFY patientIdChanged)
+    Q_PROPERTY(QString heartRateValue READ heartRateValue NOTIFY heartRateChanged)
+    Q_PROPERTY(QString spo2Value READ spo2Value NOTIFY spo2Changed)
+    Q_PROPERTY(QString respirationRate READ respirationRate NOTIFY respirationRateChanged)
+    Q_PROPERTY(bool isMonitoring READ isMonitoring NOTIFY monitoringChanged)
+    Q_PROPERTY(bool subscribed READ subscribed NOTIFY subscribedChanged)
+    Q_PROPERTY(WaveformBuffer* ecgBuffer READ ecgBuffer CONSTANT)
+    Q_PROPERTY(WaveformBuffer* plethBuffer READ plethBuffer CONSTANT)
+    Q_PROPERTY(WaveformBuffer* respBuffer READ respBuffer CONSTANT)
+
+public:
+    // The device is moved to workerThread; start() begins acquisition
+    BedContext(const QString &bedId, const QString &portName, QThread *workerThread, QObject *parent = nullptr);
+    ~BedContext();
+
+    QString bedId() const { return m_bedId; }
+    QString portName() const { return m_portName; }
+    QThread *workerThread() const { return m_workerThread; }
+
+    QString patientId() const { return m_patientId; }
+    void setPatientId(const QString &patientId);
+
+    QString heartRateValue() const { return m_device->heartRateValue(); }
+    QString spo2Value() const { return m_device->spo2Value(); }
+    QString respirationRate() const { return m_device->respirationRate(); }
+    bool isMonitoring() const { return m_device->isMonitoring(); }
+
+    WaveformBuffer* ecgBuffer() const { return m_ecgBuffer; }
+    WaveformBuffer* plethBuffer() const { return m_plethBuffer; }
+    WaveformBuffer* respBuffer() const { return m_respBuffer; }
+
+    // Reference counted; every subscribe() needs a matching unsubscribe()
+    bool subscribed() const { return m_subscribers > 0; }
+    Q_INVOKABLE void subscribe();
+    Q_INVOKABLE void unsubscribe();
+
+    // Lead copied into ecgBuffer
+    int ecgLead() const { return m_device->ecgLead(); }
+    void setEcgLead(int lead);
+
+    Q_INVOKABLE int queueDepth() const { return m_device->queueDepth(); }
+    Q_INVOKABLE quint64 droppedSamples() const { return m_device->droppedEvents(); }
+    Q_INVOKABLE qint64 timeToFirstWaveformMs() const { return m_device->timeToFirstWaveformMs(); }
+    Q_INVOKABLE QVariantList channelStatus() const { return m_device->channelStatus(); }
+
+public slots:
+
+    void start();
+    void stop();
+
+signals:
+
+    void patientIdChanged();
+    void heartRateChanged();
+    void spo2Changed();
+    void respirationRateChanged();
+    void monitoringChanged();
+    void subscribedChanged();
+
+private:
+    void storeMeasurement();
+    void appendWaveforms();
+
+    QString m_bedId;
+    QString m_portName;
+    QString m_patientId;
+    QThread *m_workerThread;
+    SMMProtocolTest *m_device;
+
+    WaveformBuffer *m_ecgBuffer;
+    WaveformBuffer *m_plethBuffer;
+    WaveformBuffer *m_respBuffer;
+
+    VitalSource::WaveformBatch m_waveformBatch;
+    int m_subscribers = 0;
+};
+
+#endif // BEDCONTEXT_H
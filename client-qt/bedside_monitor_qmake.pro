@@ -1,4 +1,4 @@
-QT += core gui qml quick serialport sql printsupport quickcontrols2
+QT += core gui qml quick serialport sql printsupport quickcontrols2 widgets
 
 CONFIG += c++17
 CONFIG += qt quick
@@ -6,17 +6,59 @@ CONFIG += qt quick
 SOURCES += \
     main.cpp \
     smmprotocoltest.cpp \
+    smmframedecoder.cpp \
+    smmkernels.cpp \
+    smmportdiscovery.cpp \
+    smmcapture.cpp \
     testmode.cpp \
     database.cpp \
+    measurementwriter.cpp \
+    monitorrollups.cpp \
+    retentionengine.cpp \
+    sqlstatementcache.cpp \
+    downsampling.cpp \
+    patientsearchindex.cpp \
+    patientlistmodel.cpp \
+    measurementlistmodel.cpp \
     print.cpp \
-    devicemanager.cpp
+    devicemanager.cpp \
+    acquisitionpool.cpp \
+    bedcontext.cpp \
+    waveformbuffer.cpp \
+    waveformtrace.cpp \
+    waveformcodec.cpp \
+    waveformstore.cpp \
+    waveformlod.cpp \
+    waveformreview.cpp
 
 HEADERS += \
     smmprotocoltest.h \
+    smmframedecoder.h \
+    smmkernels.h \
+    smmportdiscovery.h \
+    smmcapture.h \
+    spscqueue.h \
+    vitalsource.h \
     testmode.h \
     database.h \
+    measurementwriter.h \
+    monitorrollups.h \
+    retentionengine.h \
+    sqlstatementcache.h \
+    downsampling.h \
+    patientsearchindex.h \
+    patientlistmodel.h \
+    measurementlistmodel.h \
     print.h \
-    devicemanager.h
+    devicemanager.h \
+    acquisitionpool.h \
+    bedcontext.h \
+    waveformbuffer.h \
+    waveformtrace.h \
+    waveformcodec.h \
+    waveformstore.h \
+    waveformlod.h \
+    waveformreview.h
 
 RESOURCES += \
     resources.qrc
@@ -0,0 +1,492 @@
+// Acquisition hot path: frame building, checksums, SMMProtocolTest's parser
+// on clean, noisy and fragmented streams, per-code packet handling and the
+// measurement insert. Reports bytes/s, packets/s and heap allocations per
+// packet (all threads, counted by the operator new below).
+// The sync scan and checksum are also run with every kernel level the CPU
+// supports, on a long noisy stream and optionally on a recorded capture,
+// after their results are checked against the scalar kernels (exit code 1
+// on any mismatch).
+// Usage: smmparser_bench [seconds of device traffic] [capture file]
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QDebug>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "smmcapture.h"
+#include "smmcorruption.h"
+#include "smmprotocoltest.h"
+#include "database.h"
+#include "measurementwriter.h"
+
+static std::atomic<quint64> g_allocations{0};
+
+void *operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+static volatile quint64 g_sink;
+
+struct Result
+{
+    qint64 ns = 0;
+    quint64 bytes = 0;
+    quint64 packets = 0;
+    quint64 allocations = 0;
+};
+
+template <typename Body>
+static Result measure(quint64 bytes, quint64 packets, Body &&body)
+{
+    Result result;
+    result.bytes = bytes;
+    result.packets = packets;
+
+    const quint64 allocations = g_allocations.load(std::memory_order_relaxed);
+    QElapsedTimer timer;
+    timer.start();
+    body();
+    result.ns = qMax<qint64>(1, timer.nsecsElapsed());
+    result.allocations = g_allocations.load(std::memory_order_relaxed) - allocations;
+    return result;
+}
+
+static void report(const char *name, const Result &result)
+{
+    const double seconds = result.ns / 1e9;
+    qInfo().noquote() << QString::asprintf("%-30s %9.2f MB/s %12.0f packets/s %8.2f allocs/packet",
+                                           name, result.bytes / seconds / 1e6, result.packets / seconds,
+                                           double(result.allocations) / qMax<quint64>(1, result.packets));
+}
+
+static QByteArray payload(uint8_t code, quint64 i)
+{
+    switch (code) {
+    case 0x01: {
+        QByteArray ecg(57, 0); // 7 leads x 8 samples + FLAG2
+        for (int k = 0; k < 56; ++k)
+            ecg[k] = char(96 + (i * 8 + k % 8 + k / 8 * 11) % 64);
+        return ecg;
+    }
+    case 0x03:
+        return QByteArray(1, char(128 + i % 32));
+    case 0x04:
+        return QByteArray::fromHex("0000000010") + QByteArray(1, 0); // 16 breaths/min
+    case 0x15: {
+        const int pulse = 60 + int(i % 40);
+        QByteArray pleth(6, 0);
+        pleth[1] = char(64 + i % 128);
+        pleth[3] = char(95 + i % 5);
+        pleth[4] = char(pulse >> 8);
+        pleth[5] = char(pulse & 0xFF);
+        return pleth;
+    }
+    default:
+        return QByteArray();
+    }
+}
+
+struct Traffic
+{
+    QByteArray bytes;
+    quint64 packets = 0;
+};
+
+// The device's mix: ECG at 62.5 Hz, pleth 50 Hz, resp waveform 25 Hz and
+// resp rate 1 Hz; a noiseRate fraction of the frames is damaged
+static Traffic deviceTraffic(int seconds, double noiseRate)
+{
+    QRandomGenerator random(42);
+    Traffic traffic;
+    auto add = [&](uint8_t code, quint64 i) {
+        QByteArray frame = SMMProtocolTest::createSMMPacket(code, payload(code, i));
+        if (noiseRate > 0 && random.generateDouble() < noiseRate)
+            frame = SMM::corruptFrame(frame, random);
+        traffic.bytes.append(frame);
+        ++traffic.packets;
+    };
+
+    for (quint64 ms = 0; ms < quint64(seconds) * 1000; ++ms) {
+        if (ms % 16 == 0) add(0x01, ms / 16);
+        if (ms % 20 == 0) add(0x15, ms / 20);
+        if (ms % 40 == 0) add(0x03, ms / 40);
+        if (ms % 1000 == 0) add(0x04, ms / 1000);
+    }
+    return traffic;
+}
+
+// Device traffic with a burst of line noise (no sync bytes) of up to
+// maxNoise bytes ahead of every frame, so resynchronising dominates
+static Traffic noisyTraffic(int seconds, int maxNoise)
+{
+    QRandomGenerator random(11);
+    const Traffic clean = deviceTraffic(seconds, 0.0);
+    Traffic traffic;
+    traffic.packets = clean.packets;
+
+    const char *data = clean.bytes.constData();
+    const char *end = data + clean.bytes.size();
+    while (data < end) {
+        QByteArray noise(random.bounded(maxNoise + 1), Qt::Uninitialized);
+        for (char &byte : noise)
+            byte = char(random.bounded(0x55));
+        traffic.bytes.append(noise);
+
+        // Frames are copied whole: header, then LEN + 1 more bytes
+        const int frameSize = 3 + quint8(data[2]) + 1;
+        traffic.bytes.append(data, frameSize);
+        data += frameSize;
+    }
+    return traffic;
+}
+
+static Traffic loadCapture(const QString &path)
+{
+    Traffic traffic;
+    SMMCaptureReader reader;
+    QString error;
+    if (!reader.open(path, &error))
+        qFatal("%s", qPrintable(error));
+
+    SMMCaptureReader::Chunk chunk;
+    while (reader.next(chunk))
+        traffic.bytes.append(chunk.data.data(), chunk.data.size());
+
+    SMMFrameDecoder decoder;
+    SMMFrameDecoder::Frame frame;
+    for (qsizetype done = 0; done < traffic.bytes.size();) {
+        done += decoder.ring().append(traffic.bytes.constData() + done, quint32(traffic.bytes.size() - done));
+        while (decoder.next(frame))
+            ++traffic.packets;
+    }
+    return traffic;
+}
+
+static Traffic singleCode(uint8_t code, int count)
+{
+    Traffic traffic;
+    for (int i = 0; i < count; ++i)
+        traffic.bytes.append(SMMProtocolTest::createSMMPacket(code, payload(code, quint64(i))));
+    traffic.packets = quint64(count);
+    return traffic;
+}
+
+// Read sizes as the port would deliver them, drawn before timing starts
+static std::vector<int> chunks(qsizetype total, int minSize, int maxSize)
+{
+    QRandomGenerator random(7);
+    std::vector<int> sizes;
+    for (qsizetype done = 0; done < total;) {
+        const int size = int(qMin<qsizetype>(total - done, minSize + random.bounded(maxSize - minSize + 1)));
+        sizes.push_back(size);
+        done += size;
+    }
+    return sizes;
+}
+
+// SMMProtocolTest::feedBytes() goes through the ring, parseBufferedData()
+// and parsePacketByCode() exactly like readData()
+static Result parse(const Traffic &traffic, const std::vector<int> &sizes)
+{
+    SMMProtocolTest device;
+    VitalSource::WaveformBatch batch;
+    return measure(quint64(traffic.bytes.size()), traffic.packets, [&]() {
+        const char *data = traffic.bytes.constData();
+        for (int size : sizes) {
+            device.feedBytes(QByteArrayView(data, size));
+            device.takeWaveformBatch(batch); // As DeviceManager does once per frame
+            data += size;
+        }
+    });
+}
+
+// Framing alone, for telling decoder cost from packet handling cost
+static Result decodeOnly(const Traffic &traffic, const std::vector<int> &sizes)
+{
+    SMMFrameDecoder decoder;
+    return measure(quint64(traffic.bytes.size()), traffic.packets, [&]() {
+        const char *data = traffic.bytes.constData();
+        SMMFrameDecoder::Frame frame;
+        quint64 sum = 0;
+        for (int size : sizes) {
+            while (size > 0) {
+                const quint32 accepted = decoder.ring().append(data, quint32(size));
+                data += accepted;
+                size -= int(accepted);
+                while (decoder.next(frame))
+                    sum += frame.code;
+            }
+        }
+        g_sink = sum;
+    });
+}
+
+static void benchmarkPackets(int count)
+{
+    const QList<QPair<uint8_t, QByteArray>> commands = {
+        {0x01, QByteArray::fromHex("0203030301000000050101")},
+        {0x02, QByteArray()},
+        {0x03, QByteArray()},
+        {0x04, QByteArray::fromHex("0100")}
+    };
+
+    quint64 bytes = 0;
+    for (const auto &command : commands)
+        bytes += quint64(SMMProtocolTest::createSMMPacket(command.first, command.second).size());
+
+    report("createSMMPacket (commands)", measure(bytes * count, quint64(commands.size()) * count, [&]() {
+        quint64 sum = 0;
+        for (int i = 0; i < count; ++i) {
+            for (const auto &command : commands)
+                sum += quint64(SMMProtocolTest::createSMMPacket(command.first, command.second).size());
+        }
+        g_sink = sum;
+    }));
+
+    for (int size : {6, 57, 255}) {
+        const QByteArray data = payload(0x01, 0).leftJustified(size, 'x', true);
+        const auto *bytesIn = reinterpret_cast<const uint8_t *>(data.constData());
+        const QByteArray name = QString("checksum (%1 bytes)").arg(size).toLatin1();
+        report(name.constData(), measure(quint64(size) * count, quint64(count), [&]() {
+            quint64 sum = 0;
+            for (int i = 0; i < count; ++i)
+                sum += SMM::checksum(bytesIn, size, uint8_t(i));
+            g_sink = sum;
+        }));
+    }
+}
+
+static void benchmarkParser(int seconds)
+{
+    const Traffic clean = deviceTraffic(seconds, 0.0);
+    const Traffic noisy = deviceTraffic(seconds, 0.02);
+    const std::vector<int> reads = chunks(clean.bytes.size(), 32, 96);
+    const std::vector<int> noisyReads = chunks(noisy.bytes.size(), 32, 96);
+    const std::vector<int> fragments = chunks(clean.bytes.size(), 1, 7);
+
+    qInfo() << "Device traffic:" << seconds << "s," << clean.packets << "packets," << clean.bytes.size() << "bytes";
+    report("decoder only, clean", decodeOnly(clean, reads));
+    report("parseBufferedData, clean", parse(clean, reads));
+    report("parseBufferedData, noisy 2%", parse(noisy, noisyReads));
+    report("parseBufferedData, 1-7 B reads", parse(clean, fragments));
+
+    for (uint8_t code : {uint8_t(0x01), uint8_t(0x03), uint8_t(0x04), uint8_t(0x15)}) {
+        const Traffic traffic = singleCode(code, seconds * 100);
+        const std::vector<int> sizes = chunks(traffic.bytes.size(), 4096, 4096);
+        const QByteArray decodeName = QString("decoder only, 0x%1").arg(code, 2, 16, QChar('0')).toLatin1();
+        const QByteArray parseName = QString("parsePacketByCode 0x%1").arg(code, 2, 16, QChar('0')).toLatin1();
+        report(decodeName.constData(), decodeOnly(traffic, sizes));
+        report(parseName.constData(), parse(traffic, sizes));
+    }
+}
+
+struct KernelCase
+{
+    const char *kernel;
+    qsizetype offset;
+    qsizetype size;
+    qsizetype pair; // Where the sync pair was placed, -1 for none
+    qint64 result;
+};
+
+// The same kernel calls for every level: the stream scanned the way the
+// parser does, a sync pair at each position of a 96-byte buffer (also cut
+// off by the buffer end) at each alignment, so pairs straddle the 16 and
+// 32 byte blocks, and checksums of every length up to three blocks
+static std::vector<KernelCase> runKernelCases(const QByteArray &stream)
+{
+    std::vector<KernelCase> cases;
+    const auto *bytes = reinterpret_cast<const uint8_t *>(stream.constData());
+    for (qsizetype at = 0; at < stream.size();) {
+        const qsizetype found = SMM::findSync(bytes + at, stream.size() - at);
+        cases.push_back({"findSync (stream)", at, stream.size() - at, -1, found});
+        if (found < 0)
+            break;
+        at += found + 1;
+    }
+
+    constexpr int Span = 96;
+    QRandomGenerator random(25);
+    uint8_t noise[32 + Span];
+    for (uint8_t &byte : noise)
+        byte = uint8_t(random.bounded(0x80)); // Never a sync byte
+
+    alignas(32) uint8_t buffer[32 + Span];
+    for (bool syncFill : {false, true}) {
+        for (int align = 0; align < 32; ++align) {
+            for (int pair = -1; pair < Span; ++pair) {
+                for (int size : {pair + 1, pair + 2, Span}) {
+                    if (size < 0 || size > Span)
+                        continue;
+                    uint8_t *data = buffer + align;
+                    for (int k = 0; k < Span; ++k)
+                        data[k] = syncFill ? SMM::SyncByte1 : noise[k];
+                    if (pair >= 0) {
+                        data[pair] = SMM::SyncByte1;
+                        if (pair + 1 < Span)
+                            data[pair + 1] = SMM::SyncByte2;
+                    }
+                    cases.push_back({syncFill ? "findSync (AA fill)" : "findSync (noise)",
+                                     align, size, pair, SMM::findSync(data, size)});
+                }
+            }
+        }
+    }
+
+    for (int align = 0; align < 32; ++align) {
+        for (int size = 0; size <= Span; ++size) {
+            for (uint8_t seed : {uint8_t(0), uint8_t(0xA5)}) {
+                for (int k = 0; k < size; ++k)
+                    buffer[align + k] = uint8_t(random.bounded(256));
+                cases.push_back({"checksum", align, size, seed, SMM::checksum(buffer + align, size, seed)});
+            }
+        }
+    }
+    return cases;
+}
+
+static bool sameCase(const KernelCase &a, const KernelCase &b)
+{
+    return qstrcmp(a.kernel, b.kernel) == 0 && a.offset == b.offset && a.size == b.size
+           && a.pair == b.pair && a.result == b.result;
+}
+
+static bool verifyKernels(const QByteArray &stream)
+{
+    const SMM::Kernels preferred = SMM::kernels();
+    SMM::setKernels(SMM::Kernels::Scalar);
+    const std::vector<KernelCase> expected = runKernelCases(stream);
+
+    bool ok = true;
+    for (SMM::Kernels level : {SMM::Kernels::Sse2, SMM::Kernels::Avx2}) {
+        if (!SMM::setKernels(level))
+            continue;
+        const std::vector<KernelCase> actual = runKernelCases(stream);
+        size_t i = 0;
+        while (i < expected.size() && i < actual.size() && sameCase(expected[i], actual[i]))
+            ++i;
+        if (i == expected.size() && i == actual.size())
+            continue;
+
+        // A stream scan that went astray shifts everything after it, so only the first difference counts
+        ok = false;
+        const KernelCase &c = i < expected.size() ? expected[i] : actual[i];
+        qCritical().noquote() << QString::asprintf("KERNEL MISMATCH: %s at %s, offset %lld, size %lld, pair/seed %lld:"
+                                                   " scalar %s, %s %s",
+                                                   SMM::kernelsName(level), c.kernel, qint64(c.offset), qint64(c.size), qint64(c.pair),
+                                                   i < expected.size() ? qPrintable(QString::number(expected[i].result)) : "nothing",
+                                                   SMM::kernelsName(level),
+                                                   i < actual.size() ? qPrintable(QString::number(actual[i].result)) : "nothing");
+    }
+    SMM::setKernels(preferred);
+    return ok;
+}
+
+static bool benchmarkKernels(const Traffic &traffic, const char *label, int checksums)
+{
+    if (!verifyKernels(traffic.bytes))
+        return false;
+
+    const std::vector<int> reads = chunks(traffic.bytes.size(), 4096, 4096);
+    const QByteArray frame = payload(0x01, 0).leftJustified(255, 'x', true);
+    const auto *bytesIn = reinterpret_cast<const uint8_t *>(frame.constData());
+    const SMM::Kernels preferred = SMM::kernels();
+
+    qInfo() << label << ":" << traffic.packets << "packets," << traffic.bytes.size() << "bytes";
+    for (SMM::Kernels level : {SMM::Kernels::Scalar, SMM::Kernels::Sse2, SMM::Kernels::Avx2}) {
+        if (!SMM::setKernels(level))
+            continue;
+
+        const QByteArray decodeName = QString("decoder only, %1").arg(SMM::kernelsName(level)).toLatin1();
+        const QByteArray checksumName = QString("checksum (255 bytes), %1").arg(SMM::kernelsName(level)).toLatin1();
+        report(decodeName.constData(), decodeOnly(traffic, reads));
+        report(checksumName.constData(), measure(255ull * checksums, quint64(checksums), [&]() {
+            quint64 sum = 0;
+            for (int i = 0; i < checksums; ++i)
+                sum += SMM::checksum(bytesIn, 255, uint8_t(i));
+            g_sink = sum;
+        }));
+    }
+    SMM::setKernels(preferred);
+    return true;
+}
+
+static void benchmarkInsert(int count)
+{
+    // databaseClass opens vitalsigns.db in the working directory
+    QTemporaryDir dir;
+    const QString previous = QDir::currentPath();
+    QDir::setCurrent(dir.path());
+    databaseClass *database = databaseClass::instance();
+    database->setupDatabase();
+
+    // Throttled to one row per 3 s; this is the per-call cost the UI pays
+    report("insertMeasurement (call)", measure(0, quint64(count), [&]() {
+        for (int i = 0; i < count; ++i)
+            database->insertMeasurement("P1", QString::number(60 + i % 40), "98", "16");
+    }));
+    database->shutdown();
+
+    // What the rows cost behind it: enqueue plus batched commits
+    MeasurementWriter writer(dir.filePath("vitalsigns.db"));
+    QThread thread;
+    writer.moveToThread(&thread);
+    thread.start();
+    QMetaObject::invokeMethod(&writer, &MeasurementWriter::open, Qt::BlockingQueuedConnection);
+
+    const quint64 committed = writer.committedRows();
+    report("MeasurementWriter commit", measure(0, quint64(count), [&]() {
+        MeasurementWriter::Measurement measurement;
+        measurement.patientId = "P1";
+        measurement.valid = MeasurementWriter::HeartRateValid | MeasurementWriter::Spo2Valid | MeasurementWriter::RespValid;
+        for (int i = 0; i < count; ++i) {
+            measurement.timestampMs = qint64(i) * 3000;
+            measurement.heartRate = 60 + i % 40;
+            measurement.spo2 = 95 + i % 5;
+            measurement.resp = 12 + i % 8;
+            writer.enqueue(measurement);
+        }
+        QMetaObject::invokeMethod(&writer, &MeasurementWriter::flush, Qt::QueuedConnection);
+        while (writer.committedRows() - committed < quint64(count) && writer.failedBatches() == 0)
+            QThread::usleep(100);
+    }));
+
+    QMetaObject::invokeMethod(&writer, &MeasurementWriter::close, Qt::BlockingQueuedConnection);
+    thread.quit();
+    thread.wait();
+    QDir::setCurrent(previous);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QLoggingCategory::setFilterRules("*.debug=false"); // Keep the tables readable
+    const int seconds = argc > 1 ? QString(argv[1]).toInt() : 600;
+
+    benchmarkPackets(seconds * 1000);
+    benchmarkParser(seconds);
+    if (!benchmarkKernels(noisyTraffic(seconds, 4096), "Noisy traffic, up to 4 KiB noise per frame", seconds * 1000))
+        return 1;
+    if (argc > 2 && !benchmarkKernels(loadCapture(QString(argv[2])), qPrintable(QString("Capture %1").arg(argv[2])), seconds * 1000))
+        return 1;
+    benchmarkInsert(seconds * 10);
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+QT += core gui qml quick serialport sql printsupport
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = smmparser_bench
+
+INCLUDEPATH += ../.. ../../tools/smmemulator
+
+# SMMProtocolTest reaches DeviceManager and the database, so the benchmark
+# links the application's sources except its main.cpp
+SOURCES += \
+    main.cpp \
+    ../../smmprotocoltest.cpp \
+    ../../smmframedecoder.cpp \
+    ../../smmkernels.cpp \
+    ../../smmportdiscovery.cpp \
+    ../../smmcapture.cpp \
+    ../../testmode.cpp \
+    ../../database.cpp \
+    ../../measurementwriter.cpp \
+    ../../monitorrollups.cpp \
+    ../../retentionengine.cpp \
+    ../../sqlstatementcache.cpp \
+    ../../downsampling.cpp \
+    ../../patientsearchindex.cpp \
+    ../../patientlistmodel.cpp \
+    ../../measurementlistmodel.cpp \
+    ../../print.cpp \
+    ../../devicemanager.cpp \
+    ../../acquisitionpool.cpp \
+    ../../bedcontext.cpp \
+    ../../waveformbuffer.cpp \
+    ../../waveformtrace.cpp \
+    ../../waveformcodec.cpp \
+    ../../waveformstore.cpp \
+    ../../waveformlod.cpp \
+    ../../waveformreview.cpp \
+    ../../tools/smmemulator/smmcorruption.cpp
+
+HEADERS += \
+    ../../smmprotocoltest.h \
+    ../../smmframedecoder.h \
+    ../../smmkernels.h \
+    ../../smmportdiscovery.h \
+    ../../smmcapture.h \
+    ../../spscqueue.h \
+    ../../vitalsource.h \
+    ../../testmode.h \
+    ../../database.h \
+    ../../measurementwriter.h \
+    ../../monitorrollups.h \
+    ../../retentionengine.h \
+    ../../sqlstatementcache.h \
+    ../../downsampling.h \
+    ../../patientsearchindex.h \
+    ../../patientlistmodel.h \
+    ../../measurementlistmodel.h \
+    ../../print.h \
+    ../../devicemanager.h \
+    ../../acquisitionpool.h \
+    ../../bedcontext.h \
+    ../../waveformbuffer.h \
+    ../../waveformtrace.h \
+    ../../waveformcodec.h \
+    ../../waveformstore.h \
+    ../../waveformlod.h \
+    ../../waveformreview.h \
+    ../../tools/smmemulator/smmcorruption.h
@@ -0,0 +1,125 @@
+// Per-call cost of preparing a statement on every call (the previous
+// databaseClass pattern) versus reusing it from SqlStatementCache.
+// Usage: statementcache_bench [calls]
+
+#include <QCoreApplication>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QDebug>
+#include <functional>
+#include "sqlstatementcache.h"
+
+static const char *InsertSql =
+    "INSERT INTO monitor_data (patient_id, timestamp_ms, heartRate, spo2, resp, valid) "
+    "VALUES (:pid, :ts, :hr, :sp, :resp, :valid)";
+static const char *FindSql =
+    "SELECT patient_id, name, surname, tc FROM patients WHERE name = :name AND surname = :surname AND tc = :tc";
+static const char *RecentSql =
+    "SELECT timestamp_ms, heartRate, spo2, resp, valid FROM monitor_data "
+    "WHERE patient_id = :pid ORDER BY timestamp_ms DESC LIMIT :limit";
+
+static void bindInsert(QSqlQuery &query, int i)
+{
+    query.bindValue(":pid", QString("P%1").arg(i % 100));
+    query.bindValue(":ts", qint64(i) * 3000);
+    query.bindValue(":hr", 60 + i % 40);
+    query.bindValue(":sp", 95 + i % 5);
+    query.bindValue(":resp", 12 + i % 8);
+    query.bindValue(":valid", 7);
+}
+
+static void bindFind(QSqlQuery &query, int i)
+{
+    const int n = i % 1000;
+    query.bindValue(":name", QString("Name%1").arg(n));
+    query.bindValue(":surname", QString("Surname%1").arg(n));
+    query.bindValue(":tc", QString("%1").arg(10000000000LL + n));
+}
+
+static void bindRecent(QSqlQuery &query, int i)
+{
+    query.bindValue(":pid", QString("P%1").arg(i % 100));
+    query.bindValue(":limit", 20);
+}
+
+static double run(const QSqlDatabase &db, int calls, const std::function<QSqlQuery &(QSqlQuery &)> &acquire,
+                  const std::function<void(QSqlQuery &, int)> &bind)
+{
+    QSqlDatabase(db).transaction();
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0; i < calls; ++i) {
+        QSqlQuery scratch(db);
+        QSqlQuery &query = acquire(scratch);
+        bind(query, i);
+        if (!query.exec())
+            qFatal("exec failed: %s", qPrintable(query.lastError().text()));
+        while (query.next()) {}
+    }
+
+    const double usPerCall = timer.nsecsElapsed() / 1000.0 / calls;
+    QSqlDatabase(db).commit();
+    return usPerCall;
+}
+
+static void compare(const QSqlDatabase &db, const char *name, const char *sql, int calls,
+                    const std::function<void(QSqlQuery &, int)> &bind)
+{
+    SqlStatementCache cache(db);
+
+    double uncached = run(db, calls, [sql](QSqlQuery &scratch) -> QSqlQuery & {
+        scratch.prepare(sql);
+        return scratch;
+    }, bind);
+
+    double cached = run(db, calls, [&cache, sql](QSqlQuery &) -> QSqlQuery & {
+        return cache.statement(sql);
+    }, bind);
+
+    qInfo().noquote() << QString::asprintf("%-22s prepare-per-call %8.2f us   cached %8.2f us   speedup %5.2fx",
+                                           name, uncached, cached, uncached / cached);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int calls = argc > 1 ? QString(argv[1]).toInt() : 20000;
+
+    QTemporaryDir dir;
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
+    db.setDatabaseName(dir.filePath("bench.db"));
+    if (!db.open())
+        qFatal("Could not open database: %s", qPrintable(db.lastError().text()));
+
+    QSqlQuery setup(db);
+    setup.exec("PRAGMA journal_mode=WAL");
+    setup.exec("PRAGMA synchronous=NORMAL");
+    setup.exec("CREATE TABLE patients (id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id TEXT UNIQUE NOT NULL, "
+               "name TEXT NOT NULL, surname TEXT NOT NULL, created_at TEXT DEFAULT CURRENT_TIMESTAMP, tc TEXT NOT NULL)");
+    setup.exec("CREATE TABLE monitor_data (id INTEGER PRIMARY KEY AUTOINCREMENT, patient_id TEXT NOT NULL, "
+               "timestamp_ms INTEGER NOT NULL, heartRate INTEGER, spo2 INTEGER, resp INTEGER, valid INTEGER NOT NULL DEFAULT 0)");
+    setup.exec("CREATE INDEX idx_monitor_data_patient_time ON monitor_data (patient_id, timestamp_ms, heartRate, spo2, resp, valid)");
+
+    db.transaction();
+    setup.prepare("INSERT INTO patients (patient_id, name, surname, tc) VALUES (?, ?, ?, ?)");
+    for (int n = 0; n < 1000; ++n) {
+        setup.addBindValue(QString("P%1").arg(n));
+        setup.addBindValue(QString("Name%1").arg(n));
+        setup.addBindValue(QString("Surname%1").arg(n));
+        setup.addBindValue(QString("%1").arg(10000000000LL + n));
+        setup.exec();
+    }
+    db.commit();
+    setup.finish();
+
+    qInfo() << "Calls per case:" << calls;
+    compare(db, "insertMeasurement", InsertSql, calls, bindInsert);
+    compare(db, "findPatient", FindSql, calls, bindFind);
+    compare(db, "getRecentMeasurements", RecentSql, calls, bindRecent);
+
+    return 0;
+}
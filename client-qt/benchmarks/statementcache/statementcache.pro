@@ -0,0 +1,16 @@
+QT += core sql
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = statementcache_bench
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    main.cpp \
+    ../../sqlstatementcache.cpp
+
+HEADERS += \
+    ../../sqlstatementcache.h
@@ -18,9 +18,6 @@ Item {
     property int spo2Value: 0
     property int respirationRate: 0
 
-    property var waveformData: []
-    property var ecgWaveformData: []
-    property var respWaveformData: []
     property int maxWaveformPoints: 200
 
     // Buffers for 5s print capture
@@ -30,6 +27,11 @@ Item {
     property var printEcgTimestamps: []
     property bool isRecordingForPrint: false
 
+    // Write cursors of the waveform buffers and wall-clock time when the capture started
+    property real printPlethStart: 0
+    property real printEcgStart: 0
+    property real printStartMs: 0
+
     // --- Printing capture: start/stop helpers ---
     function beginPrintRecording() {
         isRecordingForPrint = true
@@ -37,32 +39,51 @@ Item {
         printTimestamps = []
         printEcgData = []
         printEcgTimestamps = []
+        printPlethStart = deviceManager.plethBuffer.writeCursor
+        printEcgStart = deviceManager.ecgBuffer.writeCursor
+        printStartMs = Date.now()
         console.log("▶️ beginPrintRecording")
     }
 
     function endPrintRecording() {
+        if (!isRecordingForPrint)
+            return
         isRecordingForPrint = false
+
+        var endMs = Date.now()
+        var pleth = captureRange(deviceManager.plethBuffer, printPlethStart, printStartMs, endMs)
+        var ecg = captureRange(deviceManager.ecgBuffer, printEcgStart, printStartMs, endMs)
+        printWaveformData = pleth.samples
+        printTimestamps = pleth.timestamps
+        printEcgData = ecg.samples
+        printEcgTimestamps = ecg.timestamps
         console.log("⏹ endPrintRecording; lengths:", printWaveformData.length, printEcgData.length)
     }
 
-    // Model to hold patients fetched from the DB
-    ListModel { id: patientModel }
+    // Copies the samples written since startCursor out of a C++ buffer in one
+    // call. The buffers hold no per-sample time, so the samples are spread
+    // evenly over the capture; samples already overwritten are reported.
+    function captureRange(buffer, startCursor, startMs, endMs) {
+        var count = buffer.writeCursor - startCursor
+        var from = Math.max(startCursor, buffer.firstIndex)
+        if (from > startCursor)
+            console.warn("⚠️ Print capture outran the waveform buffer (capacity", buffer.capacity + "),",
+                         from - startCursor, "oldest samples lost")
+
+        var samples = buffer.samples(from, buffer.writeCursor - from)
+        var step = count > 0 ? (endMs - startMs) / count : 0
+        var timestamps = []
+        for (var i = 0; i < samples.length; ++i)
+            timestamps.push(new Date(startMs + (from - startCursor + i) * step))
+        return { samples: samples, timestamps: timestamps }
+    }
 
-    // Refresh patient list from DeviceManager
+    // Patients, paged in from the DB as the list scrolls
+    PatientListModel { id: patientModel }
+
+    // Drop the loaded pages so the list reads the DB again
     function refreshPatientList() {
-        patientModel.clear()
-        if (typeof deviceManager !== "undefined") {
-            var patients = deviceManager.getAllPatients()
-            for (var i = 0; i < patients.length; i++) {
-                patientModel.append({
-                    "patient_id": patients[i].patient_id,
-                    "name": patients[i].name,
-                    "surname": patients[i].surname,
-                    "tc": patients[i].tc
-                })
-            }
-            console.log("✅ Patient list refreshed:", patients.length, "records")
-        }
+        patientModel.reload()
     }
 
     // Initialize monitoring and load patients on component mount
@@ -107,9 +128,10 @@ Item {
                 Layout.fillHeight: true
                 Layout.minimumHeight: 300
 
-                ecgWaveformData: doctorView.ecgWaveformData
-                waveformData: doctorView.waveformData
-                respWaveformData: doctorView.respWaveformData
+                maxWaveformPoints: doctorView.maxWaveformPoints
+                ecgBuffer: deviceManager.ecgBuffer
+                plethBuffer: deviceManager.plethBuffer
+                respBuffer: deviceManager.respBuffer
 
                 heartValue: doctorView.heartValue
                 spo2Value: doctorView.spo2Value
@@ -159,9 +181,9 @@ Item {
                     footerBar.stopPrint()
                     deviceManager.stopMonitoring()
                     deviceManager.userRole = ""
-                    waveformData = []
-                    ecgWaveformData = []
-                    respWaveformData = []
+                    deviceManager.plethBuffer.clear()
+                    deviceManager.ecgBuffer.clear()
+                    deviceManager.respBuffer.clear()
 
                     var item = doctorView
                     while (item) {
@@ -253,38 +275,6 @@ Item {
             respirationRate = parseInt(deviceManager.respirationRate) || 0
         }
 
-        function onEcgWaveformSampleReceived() {
-            ecgWaveformData.push(deviceManager.ecgWaveformSample)
-            if (ecgWaveformData.length > maxWaveformPoints)
-                ecgWaveformData.shift()
-
-            if (isRecordingForPrint) {
-                printEcgData.push(deviceManager.ecgWaveformSample)
-                printEcgTimestamps.push(new Date())
-            }
-            graphs.refreshAll()
-        }
-
-        function onRespWaveformSampleReceived() {
-            respWaveformData.push(deviceManager.respWaveformSample)
-            if (respWaveformData.length > maxWaveformPoints)
-                respWaveformData.shift()
-
-            graphs.refreshAll()
-        }
-
-        function onWaveformSampleReceived() {
-            waveformData.push(deviceManager.waveformSample)
-            if (waveformData.length > maxWaveformPoints)
-                waveformData.shift()
-
-            if (isRecordingForPrint) {
-                printWaveformData.push(deviceManager.waveformSample)
-                printTimestamps.push(new Date())
-            }
-            graphs.refreshAll()
-        }
-
         function onSpo2Changed() {
             spo2Value = parseInt(deviceManager.spo2Value) || 0
         }
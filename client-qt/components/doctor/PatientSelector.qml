@@ -80,6 +80,7 @@ Item {
 
         onOpened: {
             // Refresh list when dialog opens
+            searchField.text = ""
             refreshPatientList()
         }
 
@@ -141,6 +142,28 @@ Item {
                     font.bold: true
                 }
 
+                // Search by name, surname or TC prefix, answered by the search index
+                TextField {
+                    id: searchField
+                    width: parent.width
+                    height: 40
+                    placeholderText: "🔍 Ad, soyad veya TC ile ara..."
+                    placeholderTextColor: "#888"
+                    font.pixelSize: 14
+                    color: "white"
+                    leftPadding: 15
+                    rightPadding: 15
+
+                    background: Rectangle {
+                        color: "#2a2a2a"
+                        border.color: searchField.focus ? "#4CAF50" : "#555"
+                        border.width: 2
+                        radius: 8
+                    }
+
+                    onTextChanged: patientModel.filter = text
+                }
+
                 // Table header row
                 Rectangle {
                     width: parent.width
@@ -212,7 +235,7 @@ Item {
                 // Patient list
                 Rectangle {
                     width: parent.width
-                    height: parent.height - 110 // Leave space for header and footer
+                    height: parent.height - 165 // Leave space for header, search field and footer
                     color: "#2a2a2a"
                     border.color: "#555"
                     border.width: 1
@@ -336,7 +359,9 @@ Item {
                         Text {
                             visible: patientListView.count === 0
                             anchors.centerIn: parent
-                            text: "📝 Henüz hasta kaydı bulunmamaktadır.\nYeni hasta eklemek için '+' butonunu kullanın."
+                            text: searchField.text.trim() !== ""
+                                  ? "🔍 Aramayla eşleşen hasta bulunamadı."
+                                  : "📝 Henüz hasta kaydı bulunmamaktadır.\nYeni hasta eklemek için '+' butonunu kullanın."
                             color: "#888"
                             font.pixelSize: 14
                             horizontalAlignment: Text.AlignHCenter
@@ -687,17 +712,12 @@ Item {
             if (name !== "" && surname !== "" && /^[0-9]{11}$/.test(tc)) {
                 if (typeof deviceManager !== "undefined"
                         && deviceManager.addPatient(id, name, surname, tc)) {
-                    patientModel.append({
-                        "patient_id": id,
-                        "name": name,
-                        "surname": surname,
-                        "displayName": name + " " + surname
-                    })
+                    // The new patient is listed in name order
+                    refreshPatientList()
 
                     selectedPatientId = id
                     selectedName = name
                     selectedSurname = surname
-                    patientComboBox.currentIndex = patientModel.count - 1
 
                     console.log("✅ Patient added:", id)
 
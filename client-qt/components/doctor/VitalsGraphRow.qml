@@ -11,10 +11,10 @@ Item {
 
     property int maxWaveformPoints: 200
 
-    // ECG data (for draw + print)
-    property var ecgWaveformData: []
-    property var respWaveformData: []
-    property var waveformData: []
+    // Waveform sources (C++ ring buffers filled by DeviceManager)
+    property WaveformBuffer ecgBuffer: null
+    property WaveformBuffer respBuffer: null
+    property WaveformBuffer plethBuffer: null
 
     property int heartValue: 70
     property int spo2Value: 0
@@ -22,9 +22,9 @@ Item {
 
     // 🔄 Public helper to trigger repaints from outside
     function refreshAll() {
-        ecgCanvas.requestPaint()
-        waveformCanvas.requestPaint()
-        respCanvas.requestPaint()
+        ecgTrace.update()
+        waveformTrace.update()
+        respTrace.update()
     }
 
     ColumnLayout { // Main layout
@@ -48,31 +48,14 @@ Item {
                 border.width: 1
                 radius: 8 // A bit more aesthetic
 
-                Canvas {
-                    id: ecgCanvas
+                WaveformTrace {
+                    id: ecgTrace
                     anchors.fill: parent
-                    onPaint: {
-                        var ctx = getContext("2d")
-                        ctx.clearRect(0, 0, width, height)
-                        ctx.strokeStyle = "#4CAF50"
-                        ctx.lineWidth = 2
-                        ctx.beginPath()
-
-                        if (ecgWaveformData.length === 0) {
-                            ctx.moveTo(0, height / 2)
-                            ctx.lineTo(width, height / 2)
-                        } else {
-                            for (var i = 0; i < ecgWaveformData.length; i++) {
-                                var x = (i / maxWaveformPoints) * width
-                                var y = height - (ecgWaveformData[i] / 255.0) * height
-                                if (i === 0)
-                                    ctx.moveTo(x, y)
-                                else
-                                    ctx.lineTo(x, y)
-                            }
-                        }
-                        ctx.stroke()
-                    }
+                    anchors.margins: 4
+                    buffer: ecgBuffer
+                    color: "#4CAF50"
+                    lineWidth: 2
+                    visibleSamples: maxWaveformPoints
                 }
             }
 
@@ -129,35 +112,14 @@ Item {
                 border.width: 1
                 radius: 8 // A bit more aesthetic
 
-                Canvas {
-                    id: waveformCanvas
+                WaveformTrace {
+                    id: waveformTrace
                     anchors.fill: parent
-                    onPaint: {
-                        var ctx = getContext("2d")
-                        ctx.clearRect(0, 0, width, height)
-                        ctx.strokeStyle = "#00bcd4"
-                        ctx.lineWidth = 2
-                        ctx.beginPath()
-
-                        if (waveformData.length === 0) {
-                            ctx.moveTo(0, height / 2)
-                            ctx.lineTo(width, height / 2)
-                        } else {
-                            for (var i = 0; i < waveformData.length; i++) {
-                                var x = (i / maxWaveformPoints) * width
-                                var y = height - (waveformData[i] / 255.0) * height
-                                if (i === 0)
-                                    ctx.moveTo(x, y)
-                                else
-                                    ctx.lineTo(x, y)
-                            }
-                        }
-                        ctx.stroke()
-                        ctx.shadowColor = "#00bcd4"
-                        ctx.shadowBlur = 8
-                        ctx.stroke()
-                        ctx.shadowBlur = 0
-                    }
+                    anchors.margins: 4
+                    buffer: plethBuffer
+                    color: "#00bcd4"
+                    lineWidth: 2
+                    visibleSamples: maxWaveformPoints
                 }
             }
 
@@ -214,37 +176,14 @@ Item {
                 border.width: 1
                 radius: 8 // A bit more aesthetic
 
-                Canvas {
-                    id: respCanvas
+                WaveformTrace {
+                    id: respTrace
                     anchors.fill: parent
-
-                    onPaint: {
-                        var ctx = getContext("2d")
-                        ctx.clearRect(0, 0, width, height)
-
-                        ctx.strokeStyle = "yellow"
-                        ctx.lineWidth = 2
-                        ctx.beginPath()
-
-                        if (respWaveformData.length === 0) {
-                            // No data → draw a flat line
-                            ctx.moveTo(0, height / 2)
-                            ctx.lineTo(width, height / 2)
-                        } else {
-                            // Draw actual waveform
-                            for (var i = 0; i < respWaveformData.length; i++) {
-                                var x = (i / maxWaveformPoints) * width
-                                var y = height - (respWaveformData[i] / 255.0) * height
-
-                                if (i === 0)
-                                    ctx.moveTo(x, y)
-                                else
-                                    ctx.lineTo(x, y)
-                            }
-                        }
-
-                        ctx.stroke()
-                    }
+                    anchors.margins: 4
+                    buffer: respBuffer
+                    color: "yellow"
+                    lineWidth: 2
+                    visibleSamples: maxWaveformPoints
                 }
             }
 
@@ -1,6 +1,7 @@
 import QtQuick 2.15
 import QtQuick.Controls 2.15
 import QtQuick.Layouts 1.15
+import SMMProtocol 1.0
 
 Item {
     id: root
@@ -27,6 +28,7 @@ Item {
         onTriggered: {
             if (selectedPatientId && selectedPatientId !== "") {
                 loadHistoryData()
+                review.refresh()
             }
         }
     }
@@ -83,6 +85,106 @@ Item {
                 }
             }
 
+            // Full-disclosure waveform review: drag to scroll, wheel to zoom
+            Rectangle {
+                id: reviewPanel
+                width: parent.width
+                height: 240
+                radius: 6
+                color: "#000000"
+                border.color: "#4CAF50"
+                border.width: 1
+
+                property bool positioned: false
+
+                RowLayout {
+                    id: reviewToolbar
+                    anchors.top: parent.top
+                    anchors.left: parent.left
+                    anchors.right: parent.right
+                    anchors.margins: 8
+                    height: 32
+                    spacing: 10
+
+                    ComboBox {
+                        id: channelBox
+                        model: ["ECG I", "ECG II", "ECG III", "ECG V", "ECG aVR", "ECG aVF", "ECG aVL", "Pleth", "Resp"]
+                        Layout.preferredWidth: 120
+                    }
+
+                    Label {
+                        text: Qt.formatDateTime(new Date(review.viewStartMs), "dd.MM.yyyy hh:mm:ss")
+                              + "  (" + (review.viewSpanMs / 1000).toFixed(1) + " s)"
+                        color: "white"
+                        font.pixelSize: 14
+                        Layout.fillWidth: true
+                    }
+
+                    Button {
+                        text: "−"
+                        onClicked: zoomBy(2, review.width / 2)
+                    }
+
+                    Button {
+                        text: "+"
+                        onClicked: zoomBy(0.5, review.width / 2)
+                    }
+
+                    Button {
+                        text: "Son"
+                        onClicked: showLatest()
+                    }
+                }
+
+                WaveformReview {
+                    id: review
+                    anchors.top: reviewToolbar.bottom
+                    anchors.left: parent.left
+                    anchors.right: parent.right
+                    anchors.bottom: parent.bottom
+                    anchors.margins: 8
+                    patientId: selectedPatientId
+                    channel: channelBox.currentIndex
+                    color: channel === 7 ? "#2196F3" : (channel === 8 ? "yellow" : "#4CAF50")
+
+                    onRecordedRangeChanged: {
+                        if (!reviewPanel.positioned && recordedEndMs > 0) {
+                            showLatest()
+                            reviewPanel.positioned = true
+                        }
+                    }
+
+                    // A new patient starts at their own latest recording; the
+                    // range may already have been reloaded before this fires
+                    onPatientIdChanged: {
+                        reviewPanel.positioned = recordedEndMs > 0
+                        if (reviewPanel.positioned)
+                            showLatest()
+                    }
+
+                    MouseArea {
+                        anchors.fill: parent
+                        property real lastX: 0
+
+                        onPressed: (mouse) => lastX = mouse.x
+                        onPositionChanged: (mouse) => {
+                            var dx = mouse.x - lastX
+                            lastX = mouse.x
+                            review.viewStartMs = clampStart(review.viewStartMs - dx * review.viewSpanMs / review.width)
+                        }
+                        onWheel: (wheel) => zoomBy(wheel.angleDelta.y > 0 ? 0.8 : 1.25, wheel.x)
+                    }
+
+                    Text {
+                        anchors.centerIn: parent
+                        visible: review.loading || review.recordedEndMs === 0
+                        text: review.loading ? "Yükleniyor..." : "Kayıtlı dalga formu yok"
+                        color: "#888888"
+                        font.pixelSize: 14
+                    }
+                }
+            }
+
             // Header row
             Rectangle {
                 width: parent.width
@@ -150,8 +252,11 @@ Item {
             ListView {
                 id: historyListView
                 width: parent.width
-                height: parent.height - 160
-                model: ListModel { id: historyModel }
+                height: parent.height - 415
+                model: MeasurementListModel {
+                    id: historyModel
+                    patientId: root.selectedPatientId
+                }
                 spacing: 6
                 clip: true
 
@@ -227,42 +332,32 @@ Item {
         }
     }
 
-    // Data loading function
+    // Pulls in the measurements recorded since the last refresh; older
+    // pages are loaded by the list as it scrolls
     function loadHistoryData() {
         if (!selectedPatientId || selectedPatientId === "") {
             console.warn("❌ loadHistoryData - Patient ID is not specified!")
             return
         }
 
-        console.log("📊 Loading history data. Patient ID:", selectedPatientId)
-
-        historyModel.clear()
-
-        if (typeof deviceManager === "undefined") {
-            console.warn("❌ deviceManager is undefined!")
-            return
-        }
+        historyModel.refresh()
+    }
 
-        try {
-            var measurements = deviceManager.getRecentMeasurementsForPatient(selectedPatientId, 50)
-            console.log("📊 Number of measurements found:", measurements.length)
-
-            for (var i = 0; i < measurements.length; ++i) {
-                historyModel.append({
-                    timestamp: measurements[i].timestamp || "N/A",
-                    heartRate: measurements[i].heartRate || 0,
-                    spo2: measurements[i].spo2 || 0,
-                    resp: measurements[i].resp || 0
-                })
-            }
+    // Waveform review navigation, times in ms since the epoch
+    function clampStart(ms) {
+        var half = review.viewSpanMs / 2
+        return Math.round(Math.max(review.recordedStartMs - half, Math.min(ms, review.recordedEndMs - half)))
+    }
 
-            if (measurements.length === 0) {
-                console.log("ℹ️ No recorded measurements found for this patient")
-            }
+    function zoomBy(factor, anchorX) {
+        var anchorMs = review.viewStartMs + anchorX / review.width * review.viewSpanMs
+        var span = Math.round(Math.max(1000, Math.min(review.viewSpanMs * factor, 48 * 3600 * 1000)))
+        review.viewSpanMs = span
+        review.viewStartMs = clampStart(anchorMs - anchorX / review.width * span)
+    }
 
-        } catch (error) {
-            console.error("❌ Error while loading data:", error)
-        }
+    function showLatest() {
+        review.viewStartMs = review.recordedEndMs - review.viewSpanMs
     }
 
     // Helper to find the nearest StackView
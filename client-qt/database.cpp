@@ -1,5 +1,28 @@
 #include "database.h"
+#include "downsampling.h"
+#include "monitorrollups.h"
 #include <QCryptographicHash>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+namespace {
+// monitor_data from schema version 1 on
+QString createMeasurementsTableSql(const QString &table)
+{
+    return QString(R"(
+        CREATE TABLE IF NOT EXISTS %1 (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            patient_id TEXT NOT NULL,
+            timestamp_ms INTEGER NOT NULL,
+            heartRate INTEGER,
+            spo2 INTEGER,
+            resp INTEGER,
+            valid INTEGER NOT NULL DEFAULT 0,
+            FOREIGN KEY (patient_id) REFERENCES patients(patient_id)
+        )
+    )").arg(table);
+}
+}
 
 databaseClass::databaseClass(QObject *parent) : QObject(parent)
 {}
@@ -34,6 +57,17 @@ void databaseClass::setupDatabase()
 
     QSqlQuery query;
 
+    // WAL lets the UI connection read while the writer thread commits
+    if (!query.exec("PRAGMA journal_mode=WAL"))
+        qWarning() << "Failed to enable WAL journaling:" << query.lastError().text();
+    query.exec("PRAGMA synchronous=NORMAL");
+
+    // Pages freed by the retention engine are handed back with incremental
+    // vacuum. The mode takes effect by itself only on a new file; an existing
+    // one is converted by the retention engine on its thread, see there.
+    if (database.tables().isEmpty())
+        query.exec("PRAGMA auto_vacuum=INCREMENTAL");
+
     // Create Doctors table
     QString createDoctorTable = R"(
         CREATE TABLE IF NOT EXISTS Doctors (
@@ -55,19 +89,6 @@ void databaseClass::setupDatabase()
         )
     )";
 
-    // Create Monitor Data table
-    QString createMeasurementsTable = R"(
-        CREATE TABLE IF NOT EXISTS monitor_data (
-            id INTEGER PRIMARY KEY AUTOINCREMENT,
-            patient_id TEXT NOT NULL,
-            timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,
-            heartRate TEXT,
-            spo2 TEXT,
-            resp TEXT,
-            FOREIGN KEY (patient_id) REFERENCES patients(patient_id)
-        )
-    )";
-
     if (!query.exec(createDoctorTable))
         qWarning() << "Failed to create Doctors table:" << query.lastError().text();
     else
@@ -78,10 +99,294 @@ void databaseClass::setupDatabase()
     else
         qDebug() << "Patients table ready.";
 
-    if (!query.exec(createMeasurementsTable))
-        qWarning() << "Failed to create monitor_data table:" << query.lastError().text();
+    // Covers the keyset pages of the patient list
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_patients_name ON patients (name, surname, patient_id, tc)"))
+        qWarning() << "Failed to create patient name index:" << query.lastError().text();
+
+    // Create or upgrade the Monitor Data table
+    if (!migrateMonitorData())
+        qWarning() << "Failed to prepare monitor_data table:" << database.lastError().text();
     else
         qDebug() << "Measurements table ready.";
+
+    statements.setDatabase(database);
+    loadSearchIndex();
+    startWriter();
+    startRetention();
+}
+
+// Schema history of monitor_data (stored in PRAGMA user_version):
+//   0 - TEXT vitals ("Geçersiz" when invalid), formatted local-time timestamp
+//   1 - INTEGER vitals + validity bitmask, epoch-millisecond timestamp,
+//       covering index on (patient_id, timestamp_ms)
+//   2 - per-patient trend rollups (MonitorRollups), rebuilt from monitor_data
+//   3 - index on timestamp_ms, so retention batches are range seeks
+bool databaseClass::migrateMonitorData()
+{
+    QSqlQuery query;
+    query.exec("PRAGMA user_version");
+    const int version = query.next() ? query.value(0).toInt() : 0;
+    if (version >= MonitorDataSchemaVersion)
+        return true;
+
+    const bool legacy = version < 1 && database.tables().contains("monitor_data");
+
+    // The copy out of the TEXT schema commits batch by batch and resumes
+    // where it stopped; the remaining steps are one transaction
+    if (legacy && !copyLegacyMonitorData())
+        return false;
+
+    // Covers the history queries, which never need to touch the table itself
+    QString createHistoryIndex = R"(
+        CREATE INDEX IF NOT EXISTS idx_monitor_data_patient_time
+        ON monitor_data (patient_id, timestamp_ms, heartRate, spo2, resp, valid)
+    )";
+
+    if (version > 0 || legacy)
+        emit migrationProgress(0, 0);
+
+    database.transaction();
+
+    bool ok = true;
+    if (version < 1) {
+        if (legacy) {
+            ok = query.exec("DROP TABLE monitor_data")
+                 && query.exec("ALTER TABLE monitor_data_v1 RENAME TO monitor_data");
+        } else {
+            ok = query.exec(createMeasurementsTableSql("monitor_data"));
+        }
+        ok = ok && query.exec(createHistoryIndex);
+    }
+    if (version < 2) {
+        for (const MonitorRollups::Level &level : MonitorRollups::Levels)
+            ok = ok && query.exec(MonitorRollups::createTableSql(level));
+        ok = ok && rebuildRollupTables(query);
+    }
+    if (version < 3)
+        ok = ok && query.exec("CREATE INDEX IF NOT EXISTS idx_monitor_data_time ON monitor_data (timestamp_ms)");
+    ok = ok && query.exec(QString("PRAGMA user_version = %1").arg(MonitorDataSchemaVersion));
+
+    if (!ok) {
+        qWarning() << "monitor_data migration failed:" << query.lastError().text();
+        database.rollback();
+        return false;
+    }
+
+    database.commit();
+    if (version > 0 || legacy)
+        qDebug() << "monitor_data migrated to schema version" << MonitorDataSchemaVersion;
+    return true;
+}
+
+// Copies the TEXT-schema monitor_data into monitor_data_v1 in id order,
+// MigrationBatchRows per transaction. A copy cut short by a crash or power
+// loss continues after the highest id already in monitor_data_v1.
+bool databaseClass::copyLegacyMonitorData()
+{
+    // Only all-digit strings were real readings in the TEXT schema
+    QString copyLegacyRows = R"(
+        INSERT INTO monitor_data_v1 (id, patient_id, timestamp_ms, heartRate, spo2, resp, valid)
+        SELECT id,
+               patient_id,
+               COALESCE(CAST(strftime('%s', timestamp, 'utc') AS INTEGER) * 1000, 0),
+               CASE WHEN heartRate <> '' AND heartRate NOT GLOB '*[^0-9]*' THEN CAST(heartRate AS INTEGER) END,
+               CASE WHEN spo2 <> '' AND spo2 NOT GLOB '*[^0-9]*' THEN CAST(spo2 AS INTEGER) END,
+               CASE WHEN resp <> '' AND resp NOT GLOB '*[^0-9]*' THEN CAST(resp AS INTEGER) END,
+               (CASE WHEN heartRate <> '' AND heartRate NOT GLOB '*[^0-9]*' THEN 1 ELSE 0 END)
+             | (CASE WHEN spo2 <> '' AND spo2 NOT GLOB '*[^0-9]*' THEN 2 ELSE 0 END)
+             | (CASE WHEN resp <> '' AND resp NOT GLOB '*[^0-9]*' THEN 4 ELSE 0 END)
+        FROM monitor_data
+        WHERE id > :lastId
+        ORDER BY id
+        LIMIT :limit
+    )";
+
+    QSqlQuery query;
+    if (!query.exec(createMeasurementsTableSql("monitor_data_v1"))
+        || !query.exec("SELECT COUNT(*) FROM monitor_data") || !query.next()) {
+        qWarning() << "monitor_data migration failed:" << query.lastError().text();
+        return false;
+    }
+    const qint64 totalRows = query.value(0).toLongLong();
+
+    if (!query.exec("SELECT COALESCE(MAX(id), 0), COUNT(*) FROM monitor_data_v1") || !query.next()) {
+        qWarning() << "monitor_data migration failed:" << query.lastError().text();
+        return false;
+    }
+    qint64 lastId = query.value(0).toLongLong();
+    qint64 copiedRows = query.value(1).toLongLong();
+    query.finish();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    forever {
+        emit migrationProgress(copiedRows, totalRows);
+
+        database.transaction();
+        bool ok = query.prepare(copyLegacyRows);
+        if (ok) {
+            query.bindValue(":lastId", lastId);
+            query.bindValue(":limit", MigrationBatchRows);
+            ok = query.exec();
+        }
+        const int copied = ok ? query.numRowsAffected() : 0;
+        ok = ok && query.exec("SELECT COALESCE(MAX(id), 0) FROM monitor_data_v1") && query.next();
+        if (ok)
+            lastId = query.value(0).toLongLong();
+        query.finish();
+
+        if (!ok || !database.commit()) {
+            qWarning() << "monitor_data migration failed:" << query.lastError().text();
+            database.rollback();
+            return false;
+        }
+        if (copied == 0)
+            break;
+        copiedRows += copied;
+    }
+
+    qDebug() << "Copied" << copiedRows << "monitor_data rows to the numeric schema in" << timer.elapsed() << "ms";
+    return true;
+}
+
+// Recomputes the rollups from monitor_data, inside the caller's transaction.
+// Rollup rows older than the oldest raw row are kept: they are all that is
+// left of the rows the retention engine has aged out. Retention cuts on an
+// hour boundary, so the first remaining bucket of every level is complete.
+bool databaseClass::rebuildRollupTables(QSqlQuery &query)
+{
+    if (!query.exec("SELECT MIN(timestamp_ms) FROM monitor_data"))
+        return false;
+    if (!query.next() || query.value(0).isNull())
+        return true;
+
+    const qint64 align = MonitorRollups::Levels[MonitorRollups::LevelCount - 1].resolutionMs;
+    const qint64 startMs = query.value(0).toLongLong() / align * align;
+    query.finish();
+
+    for (const MonitorRollups::Level &level : MonitorRollups::Levels) {
+        if (!query.prepare(QString("DELETE FROM %1 WHERE bucket_ms >= :start").arg(level.table)))
+            return false;
+        query.bindValue(":start", startMs);
+        if (!query.exec() || !query.prepare(MonitorRollups::rebuildSql(level)))
+            return false;
+        query.bindValue(":start", startMs);
+        if (!query.exec())
+            return false;
+    }
+    return true;
+}
+
+bool databaseClass::rebuildRollups()
+{
+    if (!database.isOpen()) {
+        qWarning() << "Database is not open!";
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QSqlQuery query(database);
+    database.transaction();
+    if (!rebuildRollupTables(query)) {
+        qWarning() << "Rollup rebuild failed:" << query.lastError().text();
+        database.rollback();
+        return false;
+    }
+    database.commit();
+
+    qDebug() << "Rollups rebuilt in" << timer.elapsed() << "ms";
+    return true;
+}
+
+void databaseClass::startWriter()
+{
+    writerThread = new QThread(this);
+    writerThread->setObjectName("MeasurementWriter");
+
+    writer = new MeasurementWriter(database.databaseName());
+    writer->moveToThread(writerThread);
+    connect(writerThread, &QThread::started, writer, &MeasurementWriter::open);
+    connect(writerThread, &QThread::finished, writer, &QObject::deleteLater);
+    writerThread->start(QThread::LowPriority);
+
+    if (QCoreApplication::instance())
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &databaseClass::shutdown);
+}
+
+void databaseClass::startRetention()
+{
+    retentionThread = new QThread(this);
+    retentionThread->setObjectName("Retention");
+
+    retention = new RetentionEngine(database.databaseName());
+    retention->moveToThread(retentionThread);
+    connect(retentionThread, &QThread::started, retention, &RetentionEngine::open);
+    connect(retentionThread, &QThread::finished, retention, &QObject::deleteLater);
+    retentionThread->start(QThread::LowestPriority);
+}
+
+void databaseClass::setRetentionPolicy(int rawDays, int minuteRollupDays)
+{
+    if (!retention)
+        return;
+
+    QMetaObject::invokeMethod(retention, [engine = retention, rawDays, minuteRollupDays]() {
+        RetentionEngine::Policy policy;
+        policy.rawDays = rawDays;
+        policy.minuteRollupDays = minuteRollupDays;
+        engine->setPolicy(policy);
+    });
+}
+
+QVariantMap databaseClass::retentionStats() const
+{
+    QVariantMap stats;
+    if (!retention)
+        return stats;
+
+    stats["deletedRows"] = retention->deletedRows();
+    stats["vacuumedPages"] = retention->vacuumedPages();
+    stats["lastPassMs"] = retention->lastPassMs();
+    stats["maxBatchMs"] = retention->maxBatchMs();
+    return stats;
+}
+
+void databaseClass::shutdown()
+{
+    if (retentionThread) {
+        QMetaObject::invokeMethod(retention, &RetentionEngine::close, Qt::BlockingQueuedConnection);
+        retentionThread->quit();
+        retentionThread->wait();
+        retentionThread = nullptr;
+        retention = nullptr;
+    }
+
+    if (!writerThread)
+        return;
+
+    QMetaObject::invokeMethod(writer, &MeasurementWriter::close, Qt::BlockingQueuedConnection);
+    writerThread->quit();
+    writerThread->wait();
+    writerThread = nullptr;
+    writer = nullptr;
+}
+
+QVariantMap databaseClass::writerStats() const
+{
+    QVariantMap stats;
+    if (!writer)
+        return stats;
+
+    stats["queueDepth"] = writer->queueDepth();
+    stats["lastCommitMs"] = writer->lastCommitMs();
+    stats["maxCommitMs"] = writer->maxCommitMs();
+    stats["committedRows"] = writer->committedRows();
+    stats["failedBatches"] = writer->failedBatches();
+    stats["droppedRows"] = writer->droppedRows();
+    return stats;
 }
 
 QVariantList databaseClass::getAllPatients()
@@ -93,8 +398,7 @@ QVariantList databaseClass::getAllPatients()
         return patients;
     }
 
-    QSqlQuery query;
-    query.prepare("SELECT patient_id, name, surname, tc FROM patients ORDER BY name, surname");
+    QSqlQuery &query = statements.statement("SELECT patient_id, name, surname, tc FROM patients ORDER BY name, surname");
 
     if (query.exec()) {
         while (query.next()) {
@@ -113,22 +417,91 @@ QVariantList databaseClass::getAllPatients()
     return patients;
 }
 
-bool databaseClass::addPatient(const QString& patientId, const QString& name, const QString& surname)
+QVector<databaseClass::PatientRecord> databaseClass::getPatientPage(const PatientRecord *after, int limit)
+{
+    QVector<PatientRecord> patients;
+
+    if (!database.isOpen()) {
+        qWarning() << "Database is not open!";
+        return patients;
+    }
+
+    QSqlQuery &query = after
+        ? statements.statement("SELECT patient_id, name, surname, tc FROM patients "
+                               "WHERE (name, surname, patient_id) > (:name, :surname, :pid) "
+                               "ORDER BY name, surname, patient_id LIMIT :limit")
+        : statements.statement("SELECT patient_id, name, surname, tc FROM patients "
+                               "ORDER BY name, surname, patient_id LIMIT :limit");
+    if (after) {
+        query.bindValue(":name", after->name);
+        query.bindValue(":surname", after->surname);
+        query.bindValue(":pid", after->patientId);
+    }
+    query.bindValue(":limit", limit);
+
+    if (!query.exec()) {
+        qWarning() << "❌ Failed to retrieve patient page:" << query.lastError().text();
+        return patients;
+    }
+
+    patients.reserve(limit);
+    while (query.next())
+        patients.append({query.value(0).toString(), query.value(1).toString(),
+                         query.value(2).toString(), query.value(3).toString()});
+    query.finish();
+    return patients;
+}
+
+void databaseClass::loadSearchIndex()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    searchIndex.clear();
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    if (query.exec("SELECT COUNT(*) FROM patients") && query.next())
+        searchIndex.reserve(query.value(0).toInt());
+
+    if (!query.exec("SELECT patient_id, name, surname, tc FROM patients")) {
+        qWarning() << "Failed to load the patient search index:" << query.lastError().text();
+        return;
+    }
+    while (query.next())
+        searchIndex.load({query.value(0).toString(), query.value(1).toString(),
+                          query.value(2).toString(), query.value(3).toString()});
+    searchIndex.finishLoad();
+
+    qDebug() << "Patient search index:" << searchIndex.size() << "patients in" << timer.elapsed() << "ms";
+}
+
+QVector<databaseClass::PatientRecord> databaseClass::searchPatients(const QString& query, int limit)
+{
+    QVector<PatientRecord> patients;
+    const QVector<int> matches = searchIndex.search(query, limit);
+    patients.reserve(matches.size());
+    for (int index : matches)
+        patients.append(searchIndex.patient(index));
+    return patients;
+}
+
+bool databaseClass::addPatient(const QString& patientId, const QString& name, const QString& surname, const QString& tc)
 {
     if (!database.isOpen())
         return false;
 
-    QSqlQuery query;
-    query.prepare("INSERT INTO patients (patient_id, name, surname) VALUES (?, ?, ?)");
-    query.addBindValue(patientId);
-    query.addBindValue(name);
-    query.addBindValue(surname);
+    QSqlQuery &query = statements.statement("INSERT INTO patients (patient_id, name, surname, tc) VALUES (:id, :name, :surname, :tc)");
+    query.bindValue(":id", patientId);
+    query.bindValue(":name", name);
+    query.bindValue(":surname", surname);
+    query.bindValue(":tc", tc);
 
     if (!query.exec()) {
         qWarning() << "Failed to add patient:" << query.lastError().text();
         return false;
     }
 
+    searchIndex.insert({patientId, name, surname, tc});
     qDebug() << "New patient added:" << patientId << name << surname;
     return true;
 }
@@ -136,8 +509,7 @@ bool databaseClass::addPatient(const QString& patientId, const QString& name, co
 QVariantMap databaseClass::findPatient(const QString& name, const QString& surname, const QString& tc)
 {
     QVariantMap result;
-    QSqlQuery query;
-    query.prepare("SELECT patient_id, name, surname, tc FROM patients WHERE name = :name AND surname = :surname AND tc = :tc");
+    QSqlQuery &query = statements.statement("SELECT patient_id, name, surname, tc FROM patients WHERE name = :name AND surname = :surname AND tc = :tc");
     query.bindValue(":name", name);
     query.bindValue(":surname", surname);
     query.bindValue(":tc", tc);
@@ -148,14 +520,157 @@ QVariantMap databaseClass::findPatient(const QString& name, const QString& surna
         result["surname"] = query.value("surname").toString();
         result["tc"] = query.value("tc").toString();
     }
+    query.finish(); // Don't hold the read snapshot until the next call
 
     return result;
 }
 
+QVariantList databaseClass::getMeasurementBuckets(const QString& patientId, qint64 fromMs, qint64 toMs, int bucketCount)
+{
+    QVariantList buckets;
+
+    if (!database.isOpen()) {
+        qWarning() << "Database is not open!";
+        return buckets;
+    }
+    if (toMs <= fromMs || bucketCount <= 0)
+        return buckets;
+
+    bucketCount = qMin(bucketCount, MaxHistoryPoints);
+    const qint64 spanMs = toMs - fromMs;
+
+    // Long ranges read the coarsest rollup that still has a row per bucket;
+    // otherwise SQLite aggregates the raw rows over the covering index.
+    // MIN/MAX/AVG skip the NULLs stored for invalid readings.
+    QString sql;
+    if (const MonitorRollups::Level *level = MonitorRollups::coarsestFor(spanMs / bucketCount)) {
+        QStringList aggregates;
+        for (const char *vital : MonitorRollups::Vitals)
+            aggregates << QString("MIN(%1_min), MAX(%1_max), SUM(%1_sum) * 1.0 / SUM(%1_count)").arg(vital);
+
+        // A rollup row that starts before fromMs still belongs to the first bucket
+        sql = QString("SELECT (bucket_ms - :from) * :buckets / :span AS bucket, SUM(count), %1 "
+                      "FROM %2 "
+                      "WHERE patient_id = :pid AND bucket_ms > :from - %3 AND bucket_ms < :to "
+                      "GROUP BY bucket ORDER BY bucket")
+                  .arg(aggregates.join(", "), level->table).arg(level->resolutionMs);
+    } else {
+        sql = "SELECT (timestamp_ms - :from) * :buckets / :span AS bucket, COUNT(*), "
+              "MIN(heartRate), MAX(heartRate), AVG(heartRate), "
+              "MIN(spo2), MAX(spo2), AVG(spo2), "
+              "MIN(resp), MAX(resp), AVG(resp) "
+              "FROM monitor_data "
+              "WHERE patient_id = :pid AND timestamp_ms >= :from AND timestamp_ms < :to "
+              "GROUP BY bucket ORDER BY bucket";
+    }
+
+    QSqlQuery &query = statements.statement(sql);
+    query.bindValue(":pid", patientId);
+    query.bindValue(":from", fromMs);
+    query.bindValue(":to", toMs);
+    query.bindValue(":span", spanMs);
+    query.bindValue(":buckets", bucketCount);
+
+    if (!query.exec()) {
+        qWarning() << "Query error:" << query.lastError().text();
+        return buckets;
+    }
+
+    // Every bucket is returned, the empty ones with count 0
+    buckets.reserve(bucketCount);
+    for (int i = 0; i < bucketCount; ++i) {
+        QVariantMap bucket;
+        bucket["startMs"] = fromMs + spanMs * i / bucketCount;
+        bucket["endMs"] = fromMs + spanMs * (i + 1) / bucketCount;
+        bucket["count"] = 0;
+        buckets.append(bucket);
+    }
+
+    static const char *const columns[] = {
+        "heartRateMin", "heartRateMax", "heartRateMean",
+        "spo2Min", "spo2Max", "spo2Mean",
+        "respMin", "respMax", "respMean"
+    };
+
+    while (query.next()) {
+        const int index = query.value(0).toInt();
+        if (index < 0 || index >= bucketCount)
+            continue;
+
+        QVariantMap bucket = buckets[index].toMap();
+        bucket["count"] = query.value(1).toInt();
+        for (int c = 0; c < 9; ++c)
+            bucket[columns[c]] = query.value(2 + c);
+        buckets[index] = bucket;
+    }
+
+    return buckets;
+}
+
+QVariantList databaseClass::getDownsampledMeasurements(const QString& patientId, const QString& vital,
+                                                       qint64 fromMs, qint64 toMs, int maxPoints)
+{
+    QVariantList points;
+
+    if (!database.isOpen()) {
+        qWarning() << "Database is not open!";
+        return points;
+    }
+    if (vital != "heartRate" && vital != "spo2" && vital != "resp") {
+        qWarning() << "Unknown vital:" << vital;
+        return points;
+    }
+    if (toMs <= fromMs || maxPoints <= 0)
+        return points;
+
+    // Long ranges are downsampled from the per-bucket means of a rollup
+    QString sql;
+    if (const MonitorRollups::Level *level = MonitorRollups::coarsestFor((toMs - fromMs) / maxPoints)) {
+        sql = QString("SELECT bucket_ms + %2, %1_sum * 1.0 / %1_count FROM %3 "
+                      "WHERE patient_id = :pid AND bucket_ms >= :from AND bucket_ms < :to "
+                      "AND %1_count > 0 ORDER BY bucket_ms")
+                  .arg(vital).arg(level->resolutionMs / 2).arg(level->table);
+    } else {
+        sql = QString("SELECT timestamp_ms, %1 FROM monitor_data "
+                      "WHERE patient_id = :pid AND timestamp_ms >= :from AND timestamp_ms < :to "
+                      "AND %1 IS NOT NULL ORDER BY timestamp_ms").arg(vital);
+    }
+
+    QSqlQuery &query = statements.statement(sql);
+    query.setForwardOnly(true);
+    query.bindValue(":pid", patientId);
+    query.bindValue(":from", fromMs);
+    query.bindValue(":to", toMs);
+
+    if (!query.exec()) {
+        qWarning() << "Query error:" << query.lastError().text();
+        return points;
+    }
+
+    QVector<qint64> timestamps;
+    QVector<double> values;
+    while (query.next()) {
+        timestamps.append(query.value(0).toLongLong());
+        values.append(query.value(1).toDouble());
+    }
+
+    const QVector<int> selected = Downsampling::lttb(timestamps.constData(), values.constData(),
+                                                     int(timestamps.size()), qMin(maxPoints, MaxHistoryPoints));
+    points.reserve(selected.size());
+    for (int i : selected) {
+        QVariantMap point;
+        point["timestampMs"] = timestamps[i];
+        point["value"] = values[i];
+        points.append(point);
+    }
+
+    qDebug() << points.size() << "of" << timestamps.size() << "readings kept for" << vital << "(Patient ID:" << patientId << ")";
+    return points;
+}
+
 bool databaseClass::verifyDoctorLogin(const QString& username, const QString& password)
 {
-    QSqlQuery query;
-    query.prepare("SELECT password FROM Doctors WHERE username = :username");
+    QSqlQuery &query = statements.statement("SELECT password FROM Doctors WHERE username = :username");
     query.bindValue(":username", username);
 
     if (!query.exec() || !query.next()) {
@@ -164,6 +679,7 @@ bool databaseClass::verifyDoctorLogin(const QString& username, const QString& pa
     }
 
     QString storedHash = query.value(0).toString();
+    query.finish();
     QString inputHash = QString(QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha256).toHex());
 
     return storedHash == inputHash;
@@ -173,8 +689,7 @@ bool databaseClass::registerDoctor(const QString& username, const QString& passw
 {
     QString hashedPassword = QString(QCryptographicHash::hash(password.toUtf8(), QCryptographicHash::Sha256).toHex());
 
-    QSqlQuery query;
-    query.prepare("INSERT INTO Doctors (username, password) VALUES (:username, :password)");
+    QSqlQuery &query = statements.statement("INSERT INTO Doctors (username, password) VALUES (:username, :password)");
     query.bindValue(":username", username);
     query.bindValue(":password", hashedPassword);
 
@@ -188,40 +703,40 @@ bool databaseClass::registerDoctor(const QString& username, const QString& passw
 
 void databaseClass::insertMeasurement(const QString &patientId, const QString &heartRate, const QString &spo2, const QString &resp)
 {
-    static QDateTime lastInsertTime;
-
     if (!database.isOpen())
         return;
 
     QDateTime now = QDateTime::currentDateTime();
 
-    // Prevent inserting within 3 seconds of the last entry
-    if (lastInsertTime.isValid() && lastInsertTime.secsTo(now) < 3) {
+    // Prevent inserting within 3 seconds of the patient's last entry; every
+    // bed keeps its own pace
+    const qint64 nowMs = now.toMSecsSinceEpoch();
+    auto last = lastInsertMs.constFind(patientId);
+    if (last != lastInsertMs.constEnd() && nowMs - *last < MinInsertIntervalMs) {
         return;
     }
 
-    lastInsertTime = now;
+    lastInsertMs.insert(patientId, nowMs);
 
-    QString localTime = now.toString("yyyy-MM-dd HH:mm:ss");
+    if (!writer) {
+        qWarning() << "Measurement writer is not running!";
+        return;
+    }
 
-    QSqlQuery query;
-    query.prepare("INSERT INTO monitor_data (patient_id, timestamp, heartRate, spo2, resp) "
-                  "VALUES (:pid, :ts, :hr, :sp, :resp)");
-    query.bindValue(":pid", patientId);
-    query.bindValue(":ts", localTime);
-    query.bindValue(":hr", heartRate);
-    query.bindValue(":sp", spo2);
-    query.bindValue(":resp", resp);
+    // Non-numeric readings ("Geçersiz") are stored as NULL with their validity bit cleared
+    MeasurementWriter::Measurement measurement;
+    measurement.patientId = patientId;
+    measurement.timestampMs = nowMs;
 
-    if (!query.exec()) {
-        qWarning() << "Failed to insert measurement:" << query.lastError().text();
-    } else {
-        qDebug() << "Measurement inserted → Patient:" << patientId
-                 << "| Time:" << localTime
-                 << "| HR:" << heartRate
-                 << "| SpO2:" << spo2
-                 << "| RESP:" << resp;
-    }
+    bool ok = false;
+    measurement.heartRate = heartRate.toInt(&ok);
+    if (ok) measurement.valid |= MeasurementWriter::HeartRateValid;
+    measurement.spo2 = spo2.toInt(&ok);
+    if (ok) measurement.valid |= MeasurementWriter::Spo2Valid;
+    measurement.resp = resp.toInt(&ok);
+    if (ok) measurement.valid |= MeasurementWriter::RespValid;
+
+    writer->enqueue(measurement);
 }
 
 QVariantList databaseClass::getRecentMeasurements(const QString& patientId, int limit)
@@ -233,20 +748,26 @@ QVariantList databaseClass::getRecentMeasurements(const QString& patientId, int
         return measurements;
     }
 
-    QSqlQuery query;
-    query.prepare("SELECT timestamp, heartRate, spo2, resp FROM monitor_data "
-                  "WHERE patient_id = :pid "
-                  "ORDER BY timestamp DESC LIMIT :limit");
+    QSqlQuery &query = statements.statement("SELECT timestamp_ms, heartRate, spo2, resp, valid FROM monitor_data "
+                                            "WHERE patient_id = :pid "
+                                            "ORDER BY timestamp_ms DESC LIMIT :limit");
     query.bindValue(":pid", patientId);
     query.bindValue(":limit", limit);
 
     if (query.exec()) {
         while (query.next()) {
+            const qint64 timestampMs = query.value(0).toLongLong();
+            const int valid = query.value(4).toInt();
+            auto vital = [&](int column, int bit) {
+                return (valid & bit) ? query.value(column).toString() : QStringLiteral("Geçersiz");
+            };
+
             QVariantMap record;
-            record["timestamp"] = query.value(0).toString();
-            record["heartRate"] = query.value(1).toString();
-            record["spo2"] = query.value(2).toString();
-            record["resp"] = query.value(3).toString();
+            record["timestamp"] = QDateTime::fromMSecsSinceEpoch(timestampMs).toString("yyyy-MM-dd HH:mm:ss");
+            record["timestampMs"] = timestampMs;
+            record["heartRate"] = vital(1, MeasurementWriter::HeartRateValid);
+            record["spo2"] = vital(2, MeasurementWriter::Spo2Valid);
+            record["resp"] = vital(3, MeasurementWriter::RespValid);
             measurements.append(record);
         }
         qDebug() << measurements.count() << "records retrieved (Patient ID:" << patientId << ")";
@@ -256,3 +777,64 @@ QVariantList databaseClass::getRecentMeasurements(const QString& patientId, int
 
     return measurements;
 }
+
+// Both pages are read from idx_monitor_data_patient_time; id only breaks
+// ties between rows stamped in the same millisecond
+static QVector<databaseClass::MeasurementRecord> readMeasurementRows(QSqlQuery &query, int limit)
+{
+    QVector<databaseClass::MeasurementRecord> rows;
+    if (!query.exec()) {
+        qWarning() << "Query error:" << query.lastError().text();
+        return rows;
+    }
+
+    rows.reserve(limit);
+    while (query.next()) {
+        databaseClass::MeasurementRecord row;
+        row.id = query.value(0).toLongLong();
+        row.timestampMs = query.value(1).toLongLong();
+        row.heartRate = query.value(2).toInt();
+        row.spo2 = query.value(3).toInt();
+        row.resp = query.value(4).toInt();
+        row.valid = query.value(5).toInt();
+        rows.append(row);
+    }
+    query.finish();
+    return rows;
+}
+
+QVector<databaseClass::MeasurementRecord> databaseClass::getMeasurementPage(const QString& patientId, qint64 beforeMs,
+                                                                            qint64 beforeId, int limit)
+{
+    if (!database.isOpen()) {
+        qWarning() << "Database is not open!";
+        return {};
+    }
+
+    QSqlQuery &query = statements.statement("SELECT id, timestamp_ms, heartRate, spo2, resp, valid FROM monitor_data "
+                                            "WHERE patient_id = :pid AND (timestamp_ms, id) < (:ms, :id) "
+                                            "ORDER BY timestamp_ms DESC, id DESC LIMIT :limit");
+    query.bindValue(":pid", patientId);
+    query.bindValue(":ms", beforeMs);
+    query.bindValue(":id", beforeId);
+    query.bindValue(":limit", limit);
+    return readMeasurementRows(query, limit);
+}
+
+QVector<databaseClass::MeasurementRecord> databaseClass::getMeasurementsAfter(const QString& patientId, qint64 afterMs,
+                                                                              qint64 afterId, int limit)
+{
+    if (!database.isOpen()) {
+        qWarning() << "Database is not open!";
+        return {};
+    }
+
+    QSqlQuery &query = statements.statement("SELECT id, timestamp_ms, heartRate, spo2, resp, valid FROM monitor_data "
+                                            "WHERE patient_id = :pid AND (timestamp_ms, id) > (:ms, :id) "
+                                            "ORDER BY timestamp_ms, id LIMIT :limit");
+    query.bindValue(":pid", patientId);
+    query.bindValue(":ms", afterMs);
+    query.bindValue(":id", afterId);
+    query.bindValue(":limit", limit);
+    return readMeasurementRows(query, limit);
+}
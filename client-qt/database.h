@@ -7,14 +7,34 @@
 #include <QSqlError>
 #include <QVariantList>
 #include <QVariantMap>
+#include <QVector>
 #include <QDateTime>
 #include <QDebug>
+#include <QHash>
+#include <QThread>
+#include "measurementwriter.h"
+#include "patientsearchindex.h"
+#include "retentionengine.h"
+#include "sqlstatementcache.h"
 
 class databaseClass : public QObject
 {
     Q_OBJECT
 
 public:
+    // Rows handed to the list models, kept small so loaded pages stay cheap
+    using PatientRecord = PatientSearchIndex::Patient;
+
+    struct MeasurementRecord
+    {
+        qint64 id = 0;
+        qint64 timestampMs = 0;
+        int heartRate = 0;
+        int spo2 = 0;
+        int resp = 0;
+        int valid = 0; // MeasurementWriter::Validity bits
+    };
+
     explicit databaseClass(QObject *parent = nullptr);
 
     static databaseClass* instance();
@@ -22,12 +42,24 @@ public:
     // Database setup
     void setupDatabase();
 
-    // Insert measurement (with 3-second control)
+    // Insert measurement (at most one per patient every 3 seconds); queued to the writer thread
     Q_INVOKABLE void insertMeasurement(const QString& patientId, const QString& heartRate, const QString& spo2, const QString& resp);
 
     // Get recent measurements
     Q_INVOKABLE QVariantList getRecentMeasurements(const QString& patientId, int limit = 20);
 
+    // Fixed-size summary of [fromMs, toMs): bucketCount equal time buckets, each with
+    // startMs, endMs, count and min/max/mean per vital (undefined without a valid reading)
+    Q_INVOKABLE QVariantList getMeasurementBuckets(const QString& patientId, qint64 fromMs, qint64 toMs, int bucketCount);
+
+    // At most maxPoints valid readings of one vital ("heartRate", "spo2" or "resp")
+    // in [fromMs, toMs), picked with LTTB; each has timestampMs and value
+    Q_INVOKABLE QVariantList getDownsampledMeasurements(const QString& patientId, const QString& vital,
+                                                        qint64 fromMs, qint64 toMs, int maxPoints);
+
+    // Catch-up: recomputes the trend rollups from monitor_data
+    Q_INVOKABLE bool rebuildRollups();
+
     // Verify login credentials
     Q_INVOKABLE bool verifyDoctorLogin(const QString& username, const QString& password);
 
@@ -35,7 +67,7 @@ public:
     Q_INVOKABLE bool registerDoctor(const QString& username, const QString& password);
 
     // Add a new patient record
-    Q_INVOKABLE bool addPatient(const QString& patientId, const QString& name, const QString& surname);
+    Q_INVOKABLE bool addPatient(const QString& patientId, const QString& name, const QString& surname, const QString& tc);
 
     // Retrieve a specific patient
     QVariantMap findPatient(const QString& name, const QString& surname, const QString& tc);
@@ -43,9 +75,60 @@ public:
     // Get all patients
     QVariantList getAllPatients();
 
+    // Keyset pages for the list models. Patients come in (name, surname, patient_id)
+    // order after the given record, or from the start without one.
+    QVector<PatientRecord> getPatientPage(const PatientRecord *after, int limit);
+
+    // Search-as-you-type over name, surname and TC prefixes (see PatientSearchIndex)
+    QVector<PatientRecord> searchPatients(const QString& query, int limit);
+
+    // Measurements of a patient older than (beforeMs, beforeId), newest first,
+    // and newer than (afterMs, afterId), oldest first
+    QVector<MeasurementRecord> getMeasurementPage(const QString& patientId, qint64 beforeMs, qint64 beforeId, int limit);
+    QVector<MeasurementRecord> getMeasurementsAfter(const QString& patientId, qint64 afterMs, qint64 afterId, int limit);
+
+    // Write-behind queue metrics (queueDepth, lastCommitMs, maxCommitMs, committedRows, failedBatches, droppedRows)
+    Q_INVOKABLE QVariantMap writerStats() const;
+
+    // Raw rows older than rawDays are deleted, minute rollups after minuteRollupDays
+    Q_INVOKABLE void setRetentionPolicy(int rawDays, int minuteRollupDays);
+
+    // Retention engine metrics (deletedRows, vacuumedPages, lastPassMs, maxBatchMs)
+    Q_INVOKABLE QVariantMap retentionStats() const;
+
+    // Flushes pending measurements and stops the writer and retention threads
+    void shutdown();
+
+signals:
+    // Emitted by setupDatabase() while an existing monitor_data is upgraded:
+    // rows copied so far out of totalRows, or (0, 0) for steps without a count
+    void migrationProgress(qint64 copiedRows, qint64 totalRows);
+
 private:
 
+    static constexpr int MonitorDataSchemaVersion = 3;
+    static constexpr int MaxHistoryPoints = 10000; // Cap for bucket and point counts
+    static constexpr int MigrationBatchRows = 50000;
+    bool migrateMonitorData();
+    bool copyLegacyMonitorData();
+    bool rebuildRollupTables(QSqlQuery &query);
+
+    QThread *writerThread = nullptr;
+    MeasurementWriter *writer = nullptr;
+    void startWriter();
+
+    QThread *retentionThread = nullptr;
+    RetentionEngine *retention = nullptr;
+    void startRetention();
+
+    static constexpr qint64 MinInsertIntervalMs = 3000;
+    QHash<QString, qint64> lastInsertMs; // Per patient, for the insert throttle
+
+    PatientSearchIndex searchIndex; // Kept in sync by addPatient()
+    void loadSearchIndex();
+
     QSqlDatabase database;
+    SqlStatementCache statements; // Prepared once per connection, reused across calls
     static databaseClass* s_instance;
 };
 
@@ -13,7 +13,19 @@ DeviceManager::DeviceManager(QObject *parent) : QObject(parent)
     // Create device and helper classes
     realDevice = new SMMProtocolTest();
     testDevice = new testmode(this);
+    activeSource = realDevice;
     printer = new print(this);
+    bedPool = new AcquisitionPool(AcquisitionPool::defaultThreadCount(), this);
+
+    // Sized for a few seconds of full-rate samples plus a 5 s print capture
+    m_ecgBuffer = new WaveformBuffer(8192, this);
+    m_plethBuffer = new WaveformBuffer(2048, this);
+    m_respBuffer = new WaveformBuffer(2048, this);
+
+    batchTimer = new QTimer(this);
+    batchTimer->setSingleShot(true);
+    batchTimer->setInterval(16);
+    connect(batchTimer, &QTimer::timeout, this, &DeviceManager::flushWaveformBatch);
 
     // Setup the database
     databaseClass::instance()->setupDatabase();
@@ -24,6 +36,263 @@ DeviceManager::DeviceManager(QObject *parent) : QObject(parent)
     qDebug() << "DeviceManager initialized";
 }
 
+DeviceManager::~DeviceManager()
+{
+    // Beds stop their devices on the pool threads, which must still run
+    qDeleteAll(m_beds);
+    m_beds.clear();
+
+    if (acquisitionThread) {
+        QMetaObject::invokeMethod(realDevice, &VitalSource::stopMonitoring, Qt::BlockingQueuedConnection);
+        acquisitionThread->quit();
+        acquisitionThread->wait();
+    } else {
+        // Finishes the open waveform segments
+        realDevice->setRecordingPatient(QString());
+    }
+}
+
+bool DeviceManager::acquisitionThreadEnabled() const
+{
+    return acquisitionThread != nullptr;
+}
+
+void DeviceManager::setAcquisitionThreadEnabled(bool enabled)
+{
+    if (acquisitionThreadEnabled() == enabled)
+        return;
+
+    bool wasMonitoring = !m_testMode && realDevice->isMonitoring();
+    if (wasMonitoring) {
+        stopMonitoring();
+    }
+
+    if (enabled) {
+        acquisitionThread = new QThread(this);
+        acquisitionThread->setObjectName("SMMAcquisition");
+
+        // Port, timers and parser follow the device object to the new thread
+        realDevice->setQueuedDelivery(true);
+        realDevice->moveToThread(acquisitionThread);
+        acquisitionThread->start(QThread::HighPriority);
+    } else {
+        // moveToThread() must run on the thread the object currently lives in
+        QThread *mainThread = thread();
+        QMetaObject::invokeMethod(realDevice, [this, mainThread]() {
+            realDevice->moveToThread(mainThread);
+        }, Qt::BlockingQueuedConnection);
+
+        acquisitionThread->quit();
+        acquisitionThread->wait();
+        delete acquisitionThread;
+        acquisitionThread = nullptr;
+
+        realDevice->drainEvents();
+        realDevice->setQueuedDelivery(false);
+    }
+
+    emit acquisitionThreadEnabledChanged();
+
+    if (wasMonitoring) {
+        startMonitoring();
+    }
+
+    qDebug() << "Acquisition thread" << (enabled ? "enabled" : "disabled");
+}
+
+int DeviceManager::ecgLead() const
+{
+    return realDevice->ecgLead();
+}
+
+void DeviceManager::setEcgLead(int lead)
+{
+    if (lead < 0 || lead >= EcgBlock::LeadCount || lead == realDevice->ecgLead())
+        return;
+
+    // The lead is read where events are applied, which is always this thread
+    realDevice->setEcgLead(lead);
+    emit ecgLeadChanged();
+}
+
+int DeviceManager::batchInterval() const
+{
+    return batchTimer->interval();
+}
+
+void DeviceManager::setBatchInterval(int ms)
+{
+    ms = qMax(1, ms);
+    if (batchTimer->interval() == ms)
+        return;
+    batchTimer->setInterval(ms);
+    emit batchIntervalChanged();
+}
+
+void DeviceManager::setFrameWindow(QQuickWindow *window)
+{
+    if (frameWindow)
+        disconnect(frameWindow, nullptr, this, nullptr);
+
+    frameWindow = window;
+    if (frameWindow) {
+        // frameSwapped comes from the render thread; queue the flush onto ours
+        connect(frameWindow, &QQuickWindow::frameSwapped, this,
+                &DeviceManager::flushWaveformBatch, Qt::QueuedConnection);
+    }
+}
+
+void DeviceManager::scheduleWaveformBatch()
+{
+    if (!batchTimer->isActive())
+        batchTimer->start();
+}
+
+void DeviceManager::flushWaveformBatch()
+{
+    batchTimer->stop();
+
+    // Whatever the inactive source staged is dropped
+    VitalSource *inactiveSource = activeSource == realDevice ? static_cast<VitalSource*>(testDevice)
+                                                             : static_cast<VitalSource*>(realDevice);
+    inactiveSource->takeWaveformBatch(m_waveformBatch);
+    activeSource->takeWaveformBatch(m_waveformBatch);
+    if (m_waveformBatch.isEmpty())
+        return;
+
+    const QVector<quint8> &ecg = m_waveformBatch.samples[VitalSource::EcgWaveform];
+    const QVector<quint8> &pleth = m_waveformBatch.samples[VitalSource::PlethWaveform];
+    const QVector<quint8> &resp = m_waveformBatch.samples[VitalSource::RespWaveform];
+    m_ecgBuffer->append(ecg.constData(), int(ecg.size()));
+    m_plethBuffer->append(pleth.constData(), int(pleth.size()));
+    m_respBuffer->append(resp.constData(), int(resp.size()));
+
+    emit waveformBatchReady();
+}
+
+const EcgBlock &DeviceManager::lastEcgBlock() const
+{
+    return realDevice->ecgBlock();
+}
+
+QStringList DeviceManager::ecgLeadNames() const
+{
+    return { "Lead I", "Lead II", "Lead III", "Lead V", "Lead aVR", "Lead aVF", "Lead aVL" };
+}
+
+int DeviceManager::acquisitionQueueDepth() const
+{
+    return realDevice->queueDepth();
+}
+
+quint64 DeviceManager::droppedSamples() const
+{
+    return realDevice->droppedEvents();
+}
+
+qint64 DeviceManager::timeToFirstWaveformMs() const
+{
+    return realDevice->timeToFirstWaveformMs();
+}
+
+QVariantList DeviceManager::channelStatus() const
+{
+    return realDevice->channelStatus();
+}
+
+QVariantMap DeviceManager::measurementWriterStats() const
+{
+    return databaseClass::instance()->writerStats();
+}
+
+void DeviceManager::setCaptureFile(const QString &path)
+{
+    // The capture is written where the port is read
+    QMetaObject::invokeMethod(realDevice, [device = realDevice, path]() {
+        device->setCaptureFile(path);
+    });
+}
+
+void DeviceManager::replayCapture(const QString &path, double speed)
+{
+    // Replayed frames reach the UI through the real device
+    if (m_testMode)
+        setTestMode(false);
+
+    // Replayed vitals are not the current patient's; cleared on replayFinished
+    m_replaying = true;
+
+    QMetaObject::invokeMethod(realDevice, [device = realDevice, path, speed]() {
+        device->startReplay(path, speed);
+    });
+}
+
+void DeviceManager::stopReplay()
+{
+    QMetaObject::invokeMethod(realDevice, &SMMProtocolTest::stopReplay);
+}
+
+BedContext *DeviceManager::addBed(const QString &bedId, const QString &portName)
+{
+    if (bedId.isEmpty() || portName.isEmpty() || m_beds.contains(bedId)) {
+        qWarning() << "Cannot add bed" << bedId << "- empty or duplicate id";
+        return nullptr;
+    }
+    for (const BedContext *other : std::as_const(m_beds)) {
+        if (other->portName() == portName) {
+            qWarning() << "Cannot add bed" << bedId << "-" << portName << "is used by bed" << other->bedId();
+            return nullptr;
+        }
+    }
+
+    BedContext *bed = new BedContext(bedId, portName, bedPool->acquire(), this);
+    m_beds.insert(bedId, bed);
+    m_bedIds.append(bedId);
+    bed->start();
+
+    emit bedsChanged();
+    return bed;
+}
+
+void DeviceManager::removeBed(const QString &bedId)
+{
+    BedContext *bed = m_beds.take(bedId);
+    if (!bed)
+        return;
+
+    m_bedIds.removeOne(bedId);
+    QThread *worker = bed->workerThread();
+    delete bed;
+    bedPool->release(worker);
+
+    emit bedsChanged();
+}
+
+BedContext *DeviceManager::bed(const QString &bedId) const
+{
+    return m_beds.value(bedId);
+}
+
+QList<QObject*> DeviceManager::subscribeBeds(const QStringList &bedIds)
+{
+    QList<QObject*> beds;
+    for (const QString &bedId : bedIds) {
+        if (BedContext *bed = m_beds.value(bedId)) {
+            bed->subscribe();
+            beds.append(bed);
+        }
+    }
+    return beds;
+}
+
+void DeviceManager::unsubscribeBeds(const QStringList &bedIds)
+{
+    for (const QString &bedId : bedIds) {
+        if (BedContext *bed = m_beds.value(bedId))
+            bed->unsubscribe();
+    }
+}
+
 QString DeviceManager::userRole() const
 {
     return m_userRole;
@@ -43,13 +312,7 @@ QVariantList DeviceManager::getAllPatients()
 }
 
 bool DeviceManager::addPatient(const QString& id, const QString& name, const QString& surname, const QString& tc) {
-    QSqlQuery query;
-    query.prepare("INSERT INTO patients (patient_id, name, surname, tc) VALUES (:id, :name, :surname, :tc)");
-    query.bindValue(":id", id);
-    query.bindValue(":name", name);
-    query.bindValue(":surname", surname);
-    query.bindValue(":tc", tc);
-    return query.exec();
+    return databaseClass::instance()->addPatient(id, name, surname, tc);
 }
 
 QVariantMap DeviceManager::findPatient(const QString& name, const QString& surname, const QString& tc)
@@ -64,44 +327,34 @@ QString DeviceManager::currentPatientId() const {
 void DeviceManager::setCurrentPatientId(const QString& id) {
     if (m_currentPatientId != id) {
         m_currentPatientId = id;
+
+        // The waveform store belongs to the thread the device runs on
+        QMetaObject::invokeMethod(realDevice, [device = realDevice, id]() {
+            device->setRecordingPatient(id);
+        });
+
         emit currentPatientIdChanged();
     }
 }
 
 QString DeviceManager::heartRateValue() const
 {
-    QObject* activeDevice = getActiveDevice();
-    if (activeDevice) {
-        return activeDevice->property("heartRateValue").toString();
-    }
-    return "0";
+    return activeSource->heartRateValue();
 }
 
 QString DeviceManager::spo2Value() const
 {
-    QObject* activeDevice = getActiveDevice();
-    if (activeDevice) {
-        return activeDevice->property("spo2Value").toString();
-    }
-    return "0";
+    return activeSource->spo2Value();
 }
 
 int DeviceManager::waveformSample() const
 {
-    QObject* activeDevice = getActiveDevice();
-    if (activeDevice) {
-        return activeDevice->property("waveformSample").toInt();
-    }
-    return 0;
+    return activeSource->waveformSample();
 }
 
 bool DeviceManager::isMonitoring() const
 {
-    QObject* activeDevice = getActiveDevice();
-    if (activeDevice) {
-        return activeDevice->property("isMonitoring").toBool();
-    }
-    return false;
+    return activeSource->isMonitoring();
 }
 
 bool DeviceManager::testMode() const
@@ -111,18 +364,17 @@ bool DeviceManager::testMode() const
 
 void DeviceManager::startMonitoring()
 {
-    QObject* activeDevice = getActiveDevice();
-    if (activeDevice) {
-        QMetaObject::invokeMethod(activeDevice, "startMonitoring");
-        qDebug() << "Monitoring started on" << (m_testMode ? "test device" : "real device");
-    }
+    // Queued when the real device runs on the acquisition thread
+    QMetaObject::invokeMethod(activeSource, &VitalSource::startMonitoring);
+    qDebug() << "Monitoring started on" << (m_testMode ? "test device" : "real device");
 }
 
 void DeviceManager::stopMonitoring()
 {
-    // Stop both devices
-    QMetaObject::invokeMethod(realDevice, "stopMonitoring");
-    QMetaObject::invokeMethod(testDevice, "stopMonitoring");
+    // Stop both devices; wait for the acquisition thread so the port is really closed
+    QMetaObject::invokeMethod(realDevice, &VitalSource::stopMonitoring,
+                              acquisitionThread ? Qt::BlockingQueuedConnection : Qt::AutoConnection);
+    testDevice->stopMonitoring();
     qDebug() << "Monitoring stopped on all devices";
 }
 
@@ -138,18 +390,14 @@ void DeviceManager::setTestMode(bool enabled)
         stopMonitoring();
     }
 
-    // Disconnect current active device
-    disconnectDevice(getActiveDevice());
-
+    // Both devices stay connected; signals from the inactive one are ignored
     m_testMode = enabled;
+    activeSource = m_testMode ? static_cast<VitalSource*>(testDevice) : static_cast<VitalSource*>(realDevice);
     emit testModeChanged();
 
-    // Connect new active device
-    connectDevice(getActiveDevice());
-
     // Inform active device about test mode status
     if (m_testMode) {
-        QMetaObject::invokeMethod(testDevice, "setTestMode", Q_ARG(bool, true));
+        testDevice->setTestMode(true);
     }
 
     // Restart monitoring if it was previously running
@@ -192,45 +440,34 @@ QVariantList DeviceManager::getRecentMeasurementsForPatient(const QString& patie
     return databaseClass::instance()->getRecentMeasurements(patientId, limit);
 }
 
-QObject* DeviceManager::getActiveDevice() const
+QVariantList DeviceManager::getMeasurementBucketsForPatient(const QString& patientId, qint64 fromMs, qint64 toMs, int bucketCount)
 {
-    return m_testMode ? static_cast<QObject*>(testDevice) : static_cast<QObject*>(realDevice);
+    return databaseClass::instance()->getMeasurementBuckets(patientId, fromMs, toMs, bucketCount);
 }
 
-int DeviceManager::respWaveformSample() const {
-    QObject* activeDevice = getActiveDevice();
-    if (activeDevice) {
-        return activeDevice->property("respWaveformSample").toInt();
-    }
-    return 0;
+QVariantList DeviceManager::getDownsampledMeasurementsForPatient(const QString& patientId, const QString& vital,
+                                                                 qint64 fromMs, qint64 toMs, int maxPoints)
+{
+    return databaseClass::instance()->getDownsampledMeasurements(patientId, vital, fromMs, toMs, maxPoints);
 }
 
-void DeviceManager::onRespWaveformSampleReceived() {
-    emit respWaveformSampleReceived();
+int DeviceManager::respWaveformSample() const {
+    return activeSource->respWaveformSample();
 }
 
 int DeviceManager::ecgWaveformSample() const {
-    QObject* activeDevice = getActiveDevice();
-    if (activeDevice) {
-        return activeDevice->property("ecgWaveformSample").toInt();
-    }
-    return 0;
-}
-
-void DeviceManager::onEcgWaveformSampleReceived() {
-    emit ecgWaveformSampleReceived();
+    return activeSource->ecgWaveformSample();
 }
 
 QString DeviceManager::respirationRate() const {
-    QObject* activeDevice = getActiveDevice();
-    if (activeDevice) {
-        return activeDevice->property("respirationRate").toString();
-    }
-    return "0";
+    return activeSource->respirationRate();
 }
 
 void DeviceManager::onRespirationRateChanged()
 {
+    if (!fromActiveSource())
+        return;
+
     emit respirationRateChanged();
 }
 
@@ -239,47 +476,43 @@ void DeviceManager::setupConnections()
     // Printer connections
     connect(printer, &print::printCompleted, this, &DeviceManager::onPrintCompleted);
 
-    // Initially connect to the real device
-    connectDevice(realDevice);
+    // Queued events from the acquisition thread are applied on this (UI) thread
+    connect(realDevice, &SMMProtocolTest::eventsPending, this, [this]() {
+        realDevice->drainEvents();
+    });
+    connect(realDevice, &SMMProtocolTest::ecgBlockReceived, this, &DeviceManager::ecgBlockReceived);
+    connect(realDevice, &SMMProtocolTest::replayFinished, this, [this](quint64 bytes, quint64 frames, qint64 elapsedMs) {
+        m_replaying = false;
+        emit replayFinished(bytes, frames, elapsedMs);
+    });
+
+    // Both sources are connected once; setTestMode only swaps activeSource
+    connectSource(realDevice);
+    connectSource(testDevice);
 }
 
-void DeviceManager::connectDevice(QObject* device)
+void DeviceManager::connectSource(VitalSource* source)
 {
-    if (!device) return;
-
-    // Connect signals
-    connect(device, SIGNAL(heartRateChanged()), this, SLOT(onHeartRateChanged()));
-    connect(device, SIGNAL(spo2Changed()), this, SLOT(onSpo2Changed()));
-    connect(device, SIGNAL(waveformSampleReceived()), this, SLOT(onWaveformSampleReceived()));
-    connect(device, SIGNAL(respWaveformSampleReceived()), this, SLOT(onRespWaveformSampleReceived()));
-    connect(device, SIGNAL(ecgWaveformSampleReceived()), this, SLOT(onEcgWaveformSampleReceived()));
-    connect(device, SIGNAL(respirationRateChanged()), this, SLOT(onRespirationRateChanged()));
-    connect(device, SIGNAL(monitoringChanged()), this, SLOT(onMonitoringChanged()));
-
-    qDebug() << "Device connected:" << device->metaObject()->className();
+    connect(source, &VitalSource::heartRateChanged, this, &DeviceManager::onHeartRateChanged);
+    connect(source, &VitalSource::spo2Changed, this, &DeviceManager::onSpo2Changed);
+    connect(source, &VitalSource::waveformSamplesPending, this, &DeviceManager::scheduleWaveformBatch);
+    connect(source, &VitalSource::respirationRateChanged, this, &DeviceManager::onRespirationRateChanged);
+    connect(source, &VitalSource::monitoringChanged, this, &DeviceManager::onMonitoringChanged);
 }
 
-void DeviceManager::disconnectDevice(QObject* device)
+bool DeviceManager::fromActiveSource() const
 {
-    if (!device) return;
-
-    // Disconnect signals
-    disconnect(device, SIGNAL(heartRateChanged()), this, SLOT(onHeartRateChanged()));
-    disconnect(device, SIGNAL(spo2Changed()), this, SLOT(onSpo2Changed()));
-    disconnect(device, SIGNAL(waveformSampleReceived()), this, SLOT(onWaveformSampleReceived()));
-    disconnect(device, SIGNAL(respWaveformSampleReceived()), this, SLOT(onRespWaveformSampleReceived()));
-    disconnect(device, SIGNAL(ecgWaveformSampleReceived()), this, SLOT(onEcgWaveformSampleReceived()));
-    disconnect(device, SIGNAL(respirationRateChanged()), this, SLOT(onRespirationRateChanged()));
-    disconnect(device, SIGNAL(monitoringChanged()), this, SLOT(onMonitoringChanged()));
-
-    qDebug() << "Device disconnected:" << device->metaObject()->className();
+    return sender() == activeSource;
 }
 
 // Signal forwarding slots
 void DeviceManager::onHeartRateChanged() {
+    if (!fromActiveSource())
+        return;
+
     emit heartRateChanged();
 
-    if (!m_testMode && realDevice && !m_currentPatientId.isEmpty()) {
+    if (!m_testMode && !m_replaying && realDevice && !m_currentPatientId.isEmpty()) {
         databaseClass::instance()->insertMeasurement(
             m_currentPatientId,
             realDevice->heartRateValue(),
@@ -290,9 +523,12 @@ void DeviceManager::onHeartRateChanged() {
 }
 
 void DeviceManager::onSpo2Changed() {
+    if (!fromActiveSource())
+        return;
+
     emit spo2Changed();
 
-    if (!m_testMode && realDevice && !m_currentPatientId.isEmpty()) {
+    if (!m_testMode && !m_replaying && realDevice && !m_currentPatientId.isEmpty()) {
         databaseClass::instance()->insertMeasurement(
             m_currentPatientId,
             realDevice->heartRateValue(),
@@ -302,13 +538,11 @@ void DeviceManager::onSpo2Changed() {
     }
 }
 
-void DeviceManager::onWaveformSampleReceived()
-{
-    emit waveformSampleReceived();
-}
-
 void DeviceManager::onMonitoringChanged()
 {
+    if (!fromActiveSource())
+        return;
+
     emit monitoringChanged();
 }
 
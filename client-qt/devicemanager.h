@@ -5,10 +5,17 @@
 #include <QQmlEngine>
 #include <QVariantList>
 #include <QNetworkAccessManager>
+#include <QThread>
+#include <QTimer>
+#include <QPointer>
+#include <QQuickWindow>
 #include "smmprotocoltest.h"
 #include "testmode.h"
 #include "print.h"
 #include "database.h"
+#include "waveformbuffer.h"
+#include "acquisitionpool.h"
+#include "bedcontext.h"
 
 class DeviceManager : public QObject
 {
@@ -17,17 +24,25 @@ class DeviceManager : public QObject
 
     Q_PROPERTY(QString heartRateValue READ heartRateValue NOTIFY heartRateChanged)
     Q_PROPERTY(QString spo2Value READ spo2Value NOTIFY spo2Changed)
-    Q_PROPERTY(int waveformSample READ waveformSample NOTIFY waveformSampleReceived)
+    Q_PROPERTY(int waveformSample READ waveformSample NOTIFY waveformBatchReady)
     Q_PROPERTY(bool isMonitoring READ isMonitoring NOTIFY monitoringChanged)
     Q_PROPERTY(bool testMode READ testMode WRITE setTestMode NOTIFY testModeChanged)
-    Q_PROPERTY(int respWaveformSample READ respWaveformSample NOTIFY respWaveformSampleReceived)
-    Q_PROPERTY(int ecgWaveformSample READ ecgWaveformSample NOTIFY ecgWaveformSampleReceived)
+    Q_PROPERTY(int respWaveformSample READ respWaveformSample NOTIFY waveformBatchReady)
+    Q_PROPERTY(int ecgWaveformSample READ ecgWaveformSample NOTIFY waveformBatchReady)
     Q_PROPERTY(QString respirationRate READ respirationRate NOTIFY respirationRateChanged)
     Q_PROPERTY(QString userRole READ userRole WRITE setUserRole NOTIFY userRoleChanged)
     Q_PROPERTY(QString currentPatientId READ currentPatientId WRITE setCurrentPatientId NOTIFY currentPatientIdChanged)
+    Q_PROPERTY(WaveformBuffer* ecgBuffer READ ecgBuffer CONSTANT)
+    Q_PROPERTY(WaveformBuffer* plethBuffer READ plethBuffer CONSTANT)
+    Q_PROPERTY(WaveformBuffer* respBuffer READ respBuffer CONSTANT)
+    Q_PROPERTY(int batchInterval READ batchInterval WRITE setBatchInterval NOTIFY batchIntervalChanged)
+    Q_PROPERTY(int ecgLead READ ecgLead WRITE setEcgLead NOTIFY ecgLeadChanged)
+    Q_PROPERTY(bool acquisitionThreadEnabled READ acquisitionThreadEnabled WRITE setAcquisitionThreadEnabled NOTIFY acquisitionThreadEnabledChanged)
+    Q_PROPERTY(QStringList bedIds READ bedIds NOTIFY bedsChanged)
 
 public:
     explicit DeviceManager(QObject *parent = nullptr);
+    ~DeviceManager();
 
     QString currentPatientId() const;
     QString userRole() const;
@@ -40,12 +55,67 @@ public:
     int respWaveformSample() const;
     int ecgWaveformSample() const;
     void setUserRole(const QString& role);
+    bool acquisitionThreadEnabled() const;
+    int ecgLead() const;
+
+    // Waveform history filled from the active device, read by the renderers
+    WaveformBuffer* ecgBuffer() const { return m_ecgBuffer; }
+    WaveformBuffer* plethBuffer() const { return m_plethBuffer; }
+    WaveformBuffer* respBuffer() const { return m_respBuffer; }
+
+    // Batched waveform delivery: the active source stages its samples per
+    // channel, and they are moved into the buffers together once per
+    // rendered frame of the window, or at the latest after batchInterval ms.
+    // Each buffer then signals samplesAppended once per batch.
+    int batchInterval() const;
+    void setBatchInterval(int ms);
+    void setFrameWindow(QQuickWindow *window);
+
+    // Samples of the latest batch, valid in slots connected to waveformBatchReady
+    const VitalSource::WaveformBatch &waveformBatch() const { return m_waveformBatch; }
+
+    // Latest 7-lead ECG packet from the real device (8 samples per lead)
+    const EcgBlock &lastEcgBlock() const;
+    Q_INVOKABLE QStringList ecgLeadNames() const;
+
+    // Acquisition thread statistics
+    Q_INVOKABLE int acquisitionQueueDepth() const;
+    Q_INVOKABLE quint64 droppedSamples() const;
+    // Port open to first waveform frame of the current connection, -1 before it
+    Q_INVOKABLE qint64 timeToFirstWaveformMs() const;
+    // Per data channel: name, lastSeenMs (wall clock) and watchdog rearmCount
+    Q_INVOKABLE QVariantList channelStatus() const;
+    Q_INVOKABLE QVariantMap measurementWriterStats() const;
+
+    // Raw capture of the primary device's serial link (empty path stops),
+    // and replay of a capture through its parser, see SMMProtocolTest
+    Q_INVOKABLE void setCaptureFile(const QString &path);
+    Q_INVOKABLE void replayCapture(const QString &path, double speed = 1.0);
+    Q_INVOKABLE void stopReplay();
+
+    // Multi-bed acquisition (central station): every bed reads its own
+    // serial monitor on a thread of the acquisition pool, next to the
+    // primary device above. addBed() starts acquiring right away and returns
+    // nullptr if the id or the port is already taken.
+    Q_INVOKABLE BedContext *addBed(const QString &bedId, const QString &portName);
+    Q_INVOKABLE void removeBed(const QString &bedId);
+    Q_INVOKABLE BedContext *bed(const QString &bedId) const;
+    QStringList bedIds() const { return m_bedIds; }
+
+    // Waveforms of a bed reach its buffers while it has subscribers; returns
+    // the subscribed beds in the given order, unknown ids are skipped
+    Q_INVOKABLE QList<QObject*> subscribeBeds(const QStringList &bedIds);
+    Q_INVOKABLE void unsubscribeBeds(const QStringList &bedIds);
 
     Q_INVOKABLE bool registerDoctor(const QString &username, const QString &password);
     Q_INVOKABLE bool verifyDoctorLogin(const QString &username, const QString &password);
     Q_INVOKABLE bool addPatient(const QString& id, const QString& name, const QString& surname, const QString& tc);
     Q_INVOKABLE void setCurrentPatientId(const QString& id);
     Q_INVOKABLE QVariantList getRecentMeasurementsForPatient(const QString& patientId, int limit = 20);
+    // Pixel-sized trend queries over a time range, see databaseClass
+    Q_INVOKABLE QVariantList getMeasurementBucketsForPatient(const QString& patientId, qint64 fromMs, qint64 toMs, int bucketCount);
+    Q_INVOKABLE QVariantList getDownsampledMeasurementsForPatient(const QString& patientId, const QString& vital,
+                                                                  qint64 fromMs, qint64 toMs, int maxPoints);
     Q_INVOKABLE QVariantMap findPatient(const QString& name, const QString& surname, const QString& tc);
     Q_INVOKABLE QVariantList getAllPatients();
 
@@ -55,6 +125,9 @@ public slots:
     void startMonitoring();
     void stopMonitoring();
     void setTestMode(bool enabled);
+    void setAcquisitionThreadEnabled(bool enabled);
+    void setEcgLead(int lead);
+    void flushWaveformBatch();
 
     bool printWaveformData(const QVariantList& waveformData,
                            const QVariantList& timestamps,
@@ -75,25 +148,26 @@ signals:
     void respirationRateChanged();
     void heartRateChanged();
     void spo2Changed();
-    void waveformSampleReceived();
+    void waveformBatchReady();
     void monitoringChanged();
     void testModeChanged();
     void printCompleted(bool success, const QString& message);
-    void respWaveformSampleReceived();
-    void ecgWaveformSampleReceived();
     void userRoleChanged();
     void currentPatientIdChanged();
+    void acquisitionThreadEnabledChanged();
+    void ecgLeadChanged();
+    void ecgBlockReceived();
+    void batchIntervalChanged();
+    void bedsChanged();
+    void replayFinished(quint64 bytes, quint64 frames, qint64 elapsedMs);
 
 private slots:
 
     void onHeartRateChanged();
     void onSpo2Changed();
-    void onWaveformSampleReceived();
     void onMonitoringChanged();
     void onTestModeChanged();
     void onPrintCompleted(bool success, const QString& message);
-    void onRespWaveformSampleReceived();
-    void onEcgWaveformSampleReceived();
     void onRespirationRateChanged();
 
 private:
@@ -103,16 +177,35 @@ private:
     print *printer;
     databaseClass *database;
 
+    WaveformBuffer *m_ecgBuffer;
+    WaveformBuffer *m_plethBuffer;
+    WaveformBuffer *m_respBuffer;
+
+    // Waveform batching
+    QTimer *batchTimer;
+    QPointer<QQuickWindow> frameWindow;
+    VitalSource::WaveformBatch m_waveformBatch;
+    void scheduleWaveformBatch();
+
+    // Owns the serial port, parser and command timers in acquisition-thread mode
+    QThread *acquisitionThread = nullptr;
+
+    // Additional beds, in the order they were added
+    AcquisitionPool *bedPool;
+    QHash<QString, BedContext*> m_beds;
+    QStringList m_bedIds;
+
     // Status variables
     bool m_testMode = false;
+    bool m_replaying = false; // No measurements are stored meanwhile
 
-    // Helper function to return the active device
-    QObject* getActiveDevice() const;
+    // Device currently feeding the UI (realDevice or testDevice)
+    VitalSource *activeSource;
 
     // Functions to set up connections
     void setupConnections();
-    void connectDevice(QObject* device);
-    void disconnectDevice(QObject* device);
+    void connectSource(VitalSource* source);
+    bool fromActiveSource() const;
 
     // For user separation
     QString m_userRole = "guest"; // default
@@ -0,0 +1,72 @@
+#include "downsampling.h"
+
+#include <cmath>
+
+namespace Downsampling {
+
+QVector<int> lttb(const qint64 *x, const double *y, int count, int threshold)
+{
+    QVector<int> selected;
+
+    if (count <= 0 || threshold <= 0)
+        return selected;
+
+    if (threshold >= count) {
+        selected.reserve(count);
+        for (int i = 0; i < count; ++i)
+            selected.append(i);
+        return selected;
+    }
+
+    if (threshold < 3) {
+        selected.append(0);
+        if (threshold == 2)
+            selected.append(count - 1);
+        return selected;
+    }
+
+    selected.reserve(threshold);
+    selected.append(0);
+
+    // Times relative to the first point keep the areas exact in double
+    const qint64 origin = x[0];
+    const double every = double(count - 2) / double(threshold - 2);
+    int a = 0;
+
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        // Average of the next bucket is the third triangle corner
+        const int nextStart = int(std::floor((bucket + 1) * every)) + 1;
+        const int nextEnd = qMin(int(std::floor((bucket + 2) * every)) + 1, count);
+        double avgX = 0;
+        double avgY = 0;
+        for (int i = nextStart; i < nextEnd; ++i) {
+            avgX += double(x[i] - origin);
+            avgY += y[i];
+        }
+        const int nextSize = qMax(1, nextEnd - nextStart);
+        avgX /= nextSize;
+        avgY /= nextSize;
+
+        // Point of this bucket spanning the largest triangle with a and the average
+        const int start = int(std::floor(bucket * every)) + 1;
+        const int end = int(std::floor((bucket + 1) * every)) + 1;
+        const double ax = double(x[a] - origin);
+        const double ay = y[a];
+        double maxArea = -1;
+        int chosen = start;
+        for (int i = start; i < end; ++i) {
+            const double area = std::fabs((ax - avgX) * (y[i] - ay) - (ax - double(x[i] - origin)) * (avgY - ay));
+            if (area > maxArea) {
+                maxArea = area;
+                chosen = i;
+            }
+        }
+
+        selected.append(chosen);
+        a = chosen;
+    }
+
+    selected.append(count - 1);
+    return selected;
+}
+}
@@ -0,0 +1,15 @@
+#ifndef DOWNSAMPLING_H
+#define DOWNSAMPLING_H
+
+#include <QVector>
+#include <QtGlobal>
+
+namespace Downsampling {
+
+// Largest-Triangle-Three-Buckets: picks at most threshold of the count
+// points (x ascending) that keep the visual shape of the series. The first
+// and last points are always kept. Returns the indices of the kept points.
+QVector<int> lttb(const qint64 *x, const double *y, int count, int threshold);
+}
+
+#endif // DOWNSAMPLING_H
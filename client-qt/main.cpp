@@ -4,7 +4,14 @@
 #include <QDir>
 #include <QQmlContext>
 #include <QDebug>
+#include <QProgressDialog>
+#include <limits>
+#include "database.h"
 #include "devicemanager.h"
+#include "waveformtrace.h"
+#include "waveformreview.h"
+#include "patientlistmodel.h"
+#include "measurementlistmodel.h"
 
 int main(int argc, char *argv[])
 {
@@ -15,9 +22,33 @@ int main(int argc, char *argv[])
 
     QQmlApplicationEngine engine;
 
-    // Register DeviceManager to QML
+    // Register DeviceManager, the waveform types and the list models to QML
     qmlRegisterType<DeviceManager>("SMMProtocol", 1, 0, "DeviceManager");
+    qmlRegisterType<WaveformBuffer>("SMMProtocol", 1, 0, "WaveformBuffer");
+    qmlRegisterType<WaveformTraceItem>("SMMProtocol", 1, 0, "WaveformTrace");
+    qmlRegisterType<WaveformReviewItem>("SMMProtocol", 1, 0, "WaveformReview");
+    qmlRegisterUncreatableType<BedContext>("SMMProtocol", 1, 0, "BedContext", "Beds are created by DeviceManager.addBed()");
+    qmlRegisterType<PatientListModel>("SMMProtocol", 1, 0, "PatientListModel");
+    qmlRegisterType<MeasurementListModel>("SMMProtocol", 1, 0, "MeasurementListModel");
+
+    // Upgrading a large existing database can take minutes; show how far it is
+    // before the main window loads (DeviceManager sets up the database)
+    QProgressDialog migrationDialog("Ölçüm veritabanı güncelleniyor...", QString(), 0, 0);
+    migrationDialog.setWindowModality(Qt::ApplicationModal);
+    migrationDialog.setMinimumDuration(0);
+    migrationDialog.setAutoClose(false);
+    QObject::connect(databaseClass::instance(), &databaseClass::migrationProgress,
+                     &migrationDialog, [&migrationDialog](qint64 copiedRows, qint64 totalRows) {
+                         // Row counts are scaled to the int range of the dialog
+                         const qint64 scale = totalRows / std::numeric_limits<int>::max() + 1;
+                         migrationDialog.setMaximum(int(totalRows / scale));
+                         migrationDialog.setValue(int(copiedRows / scale));
+                         migrationDialog.show();
+                         QCoreApplication::processEvents();
+                     });
+
     DeviceManager deviceManager;
+    migrationDialog.close();
     engine.rootContext()->setContextProperty("deviceManager", &deviceManager);
 
     // Add import directory (for components folder)
@@ -35,6 +66,10 @@ int main(int argc, char *argv[])
 
     engine.load(mainQmlUrl);
 
+    // Deliver batched waveform updates once per rendered frame
+    if (!engine.rootObjects().isEmpty())
+        deviceManager.setFrameWindow(qobject_cast<QQuickWindow *>(engine.rootObjects().first()));
+
     qDebug() << "✅ QML path loaded:" << mainQmlUrl.toString();
 
     return app.exec();
@@ -0,0 +1,123 @@
+#include "measurementlistmodel.h"
+#include <QDateTime>
+#include <limits>
+
+MeasurementListModel::MeasurementListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{}
+
+int MeasurementListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : count();
+}
+
+QVariant MeasurementListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+
+    const databaseClass::MeasurementRecord &row = m_rows.at(index.row());
+    auto vital = [&row](int value, int bit) -> QVariant {
+        return (row.valid & bit) ? QString::number(value) : QStringLiteral("Geçersiz");
+    };
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case TimestampRole: return QDateTime::fromMSecsSinceEpoch(row.timestampMs).toString("yyyy-MM-dd HH:mm:ss");
+    case TimestampMsRole: return row.timestampMs;
+    case HeartRateRole: return vital(row.heartRate, MeasurementWriter::HeartRateValid);
+    case Spo2Role: return vital(row.spo2, MeasurementWriter::Spo2Valid);
+    case RespRole: return vital(row.resp, MeasurementWriter::RespValid);
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> MeasurementListModel::roleNames() const
+{
+    return {
+        {TimestampRole, "timestamp"},
+        {TimestampMsRole, "timestampMs"},
+        {HeartRateRole, "heartRate"},
+        {Spo2Role, "spo2"},
+        {RespRole, "resp"}
+    };
+}
+
+bool MeasurementListModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !m_atEnd && !m_patientId.isEmpty();
+}
+
+void MeasurementListModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    // Start above every real key when nothing is loaded yet
+    const qint64 beforeMs = m_rows.isEmpty() ? std::numeric_limits<qint64>::max() : m_rows.constLast().timestampMs;
+    const qint64 beforeId = m_rows.isEmpty() ? std::numeric_limits<qint64>::max() : m_rows.constLast().id;
+
+    const QVector<databaseClass::MeasurementRecord> page = databaseClass::instance()->getMeasurementPage(
+        m_patientId, beforeMs, beforeId, PageSize);
+    m_atEnd = page.size() < PageSize;
+    if (page.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), count(), count() + int(page.size()) - 1);
+    m_rows += page;
+    endInsertRows();
+    emit countChanged();
+}
+
+void MeasurementListModel::setPatientId(const QString &patientId)
+{
+    if (m_patientId == patientId)
+        return;
+
+    m_patientId = patientId;
+    reload();
+    emit patientIdChanged();
+}
+
+void MeasurementListModel::refresh()
+{
+    if (m_patientId.isEmpty())
+        return;
+
+    // Nothing loaded yet: the view pulls the first page itself
+    if (m_rows.isEmpty()) {
+        if (m_atEnd)
+            reload();
+        return;
+    }
+
+    const databaseClass::MeasurementRecord &newest = m_rows.constFirst();
+    const QVector<databaseClass::MeasurementRecord> rows = databaseClass::instance()->getMeasurementsAfter(
+        m_patientId, newest.timestampMs, newest.id, PageSize);
+
+    // More than a page behind: start over from the newest page instead
+    // of growing the list by everything that was missed
+    if (rows.size() >= PageSize) {
+        reload();
+        return;
+    }
+    if (rows.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), 0, int(rows.size()) - 1);
+    m_rows.insert(0, rows.size(), databaseClass::MeasurementRecord());
+    for (int i = 0; i < rows.size(); ++i)
+        m_rows[i] = rows.at(rows.size() - 1 - i);
+    endInsertRows();
+    emit countChanged();
+}
+
+void MeasurementListModel::reload()
+{
+    beginResetModel();
+    m_rows.clear();
+    m_rows.squeeze();
+    m_atEnd = false;
+    endResetModel();
+    emit countChanged();
+}
@@ -0,0 +1,61 @@
+#ifndef MEASUREMENTLISTMODEL_H
+#define MEASUREMENTLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include "database.h"
+
+// Measurement history of one patient for QML, newest first.
+// Older rows are loaded a page at a time as the view scrolls down, each page
+// a keyset query continuing after the oldest loaded row. refresh() only asks
+// for the rows written since the newest loaded one and inserts them at the
+// top, so a periodic refresh costs one small index lookup instead of a full
+// reload. Roles: timestamp (formatted), timestampMs, heartRate, spo2, resp;
+// vitals without a valid reading read "Geçersiz" as in getRecentMeasurements().
+class MeasurementListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QString patientId READ patientId WRITE setPatientId NOTIFY patientIdChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum Roles {
+        TimestampRole = Qt::UserRole + 1,
+        TimestampMsRole,
+        HeartRateRole,
+        Spo2Role,
+        RespRole
+    };
+
+    static constexpr int PageSize = 50;
+
+    explicit MeasurementListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    QString patientId() const { return m_patientId; }
+    void setPatientId(const QString &patientId);
+    int count() const { return int(m_rows.size()); }
+
+    // Prepends the rows recorded since the newest loaded one
+    Q_INVOKABLE void refresh();
+
+    // Drops the loaded pages; the view fetches the newest page again
+    Q_INVOKABLE void reload();
+
+signals:
+    void patientIdChanged();
+    void countChanged();
+
+private:
+    QString m_patientId;
+    QVector<databaseClass::MeasurementRecord> m_rows;
+    bool m_atEnd = false;
+};
+
+#endif // MEASUREMENTLISTMODEL_H
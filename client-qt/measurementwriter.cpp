@@ -0,0 +1,241 @@
+#include "measurementwriter.h"
+#include "monitorrollups.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QDebug>
+
+MeasurementWriter::MeasurementWriter(const QString &databasePath, QObject *parent)
+    : QObject(parent), m_databasePath(databasePath),
+      m_connectionName(QStringLiteral("measurement_writer"))
+{
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(MaxFlushLatencyMs);
+    connect(m_flushTimer, &QTimer::timeout, this, &MeasurementWriter::flush);
+
+    for (const MonitorRollups::Level &level : MonitorRollups::Levels)
+        m_rollupSql.append(MonitorRollups::upsertSql(level));
+}
+
+void MeasurementWriter::enqueue(const Measurement &measurement)
+{
+    int depth;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pending.append(measurement);
+        depth = m_pending.size();
+    }
+    m_queueDepth.store(depth, std::memory_order_relaxed);
+
+    // Timer and flush belong to the writer thread
+    if (depth == 1)
+        QMetaObject::invokeMethod(m_flushTimer, qOverload<>(&QTimer::start), Qt::QueuedConnection);
+    else if (depth == MaxBatchSize && !m_retrying.load(std::memory_order_relaxed))
+        QMetaObject::invokeMethod(this, &MeasurementWriter::flush, Qt::QueuedConnection);
+}
+
+void MeasurementWriter::open()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_databasePath);
+
+    if (!db.open()) {
+        qWarning() << "Measurement writer could not open database:" << db.lastError().text();
+        return;
+    }
+
+    QSqlQuery pragma(db);
+    pragma.exec("PRAGMA journal_mode=WAL");
+    pragma.exec("PRAGMA synchronous=NORMAL");
+    pragma.exec("PRAGMA busy_timeout=2000");
+
+    m_statements.setDatabase(db);
+
+    qDebug() << "Measurement writer ready.";
+}
+
+void MeasurementWriter::flush()
+{
+    m_flushTimer->stop();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_batch.swap(m_pending);
+    }
+    m_queueDepth.store(0, std::memory_order_relaxed);
+
+    if (m_batch.isEmpty())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = writeBatch();
+    const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+
+    if (!ok) {
+        m_failedBatches.fetch_add(1, std::memory_order_relaxed);
+        requeueBatch();
+        return;
+    }
+
+    m_committedRows.fetch_add(quint64(m_batch.size()), std::memory_order_relaxed);
+    m_lastCommitUs.store(elapsedUs, std::memory_order_relaxed);
+    if (elapsedUs > m_maxCommitUs.load(std::memory_order_relaxed))
+        m_maxCommitUs.store(elapsedUs, std::memory_order_relaxed);
+
+    qDebug() << "Measurement batch committed:" << m_batch.size() << "rows in" << elapsedUs / 1000.0 << "ms";
+    m_batch.clear();
+
+    if (m_retryDelayMs > 0) {
+        // Back to normal pacing; rows queued during the backoff go right away
+        m_retryDelayMs = 0;
+        m_retrying.store(false, std::memory_order_relaxed);
+        m_flushTimer->setInterval(MaxFlushLatencyMs);
+        if (queueDepth() > 0)
+            m_flushTimer->start();
+    }
+}
+
+// Inserts m_batch and its rollups in one transaction; rolled back on failure
+bool MeasurementWriter::writeBatch()
+{
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+    if (!db.isOpen()) {
+        qWarning() << "Measurement writer: database is not open";
+        return false;
+    }
+
+    if (!db.transaction()) {
+        qWarning() << "Measurement writer could not begin a transaction:" << db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery &query = m_statements.statement("INSERT INTO monitor_data (patient_id, timestamp_ms, heartRate, spo2, resp, valid) "
+                                              "VALUES (:pid, :ts, :hr, :sp, :resp, :valid)");
+
+    // Invalid readings are stored as NULL
+    const QVariant null(QMetaType::fromType<int>());
+    auto vital = [&null](const Measurement &m, int value, int bit) {
+        return (m.valid & bit) ? QVariant(value) : null;
+    };
+
+    bool ok = true;
+    for (const Measurement &m : std::as_const(m_batch)) {
+        query.bindValue(":pid", m.patientId);
+        query.bindValue(":ts", m.timestampMs);
+        query.bindValue(":hr", vital(m, m.heartRate, HeartRateValid));
+        query.bindValue(":sp", vital(m, m.spo2, Spo2Valid));
+        query.bindValue(":resp", vital(m, m.resp, RespValid));
+        query.bindValue(":valid", m.valid);
+
+        if (!query.exec()) {
+            qWarning() << "Failed to insert measurement:" << query.lastError().text();
+            ok = false;
+            break;
+        }
+    }
+
+    ok = ok && updateRollups();
+    if (ok && db.commit())
+        return true;
+
+    if (ok)
+        qWarning() << "Measurement batch commit failed:" << db.lastError().text();
+    db.rollback();
+    return false;
+}
+
+// Puts the failed batch back in front of the rows queued meanwhile and
+// schedules a retry with backoff
+void MeasurementWriter::requeueBatch()
+{
+    int depth;
+    int dropped = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_batch.append(m_pending);
+        m_pending.swap(m_batch);
+
+        if (m_pending.size() > MaxPendingRows) {
+            dropped = int(m_pending.size()) - MaxPendingRows;
+            m_pending.remove(0, dropped);
+        }
+        depth = int(m_pending.size());
+    }
+    m_batch.clear();
+    m_queueDepth.store(depth, std::memory_order_relaxed);
+    if (dropped > 0) {
+        m_droppedRows.fetch_add(quint64(dropped), std::memory_order_relaxed);
+        qWarning() << "Measurement queue full, dropped the" << dropped << "oldest rows";
+    }
+
+    m_retryDelayMs = m_retryDelayMs == 0 ? MaxFlushLatencyMs : qMin(m_retryDelayMs * 2, MaxRetryDelayMs);
+    m_retrying.store(true, std::memory_order_relaxed);
+    m_flushTimer->start(m_retryDelayMs);
+    qWarning() << "Measurement batch failed," << depth << "rows queued, retrying in" << m_retryDelayMs << "ms";
+}
+
+// Folds the batch into every rollup level, one upsert per touched bucket
+bool MeasurementWriter::updateRollups()
+{
+    static const int validBits[MonitorRollups::VitalCount] = {HeartRateValid, Spo2Valid, RespValid};
+    const QVariant null(QMetaType::fromType<int>());
+
+    for (int l = 0; l < MonitorRollups::LevelCount; ++l) {
+        const qint64 resolution = MonitorRollups::Levels[l].resolutionMs;
+
+        QHash<QPair<QString, qint64>, MonitorRollups::Bucket> buckets;
+        for (const Measurement &m : std::as_const(m_batch)) {
+            MonitorRollups::Bucket &bucket = buckets[qMakePair(m.patientId, m.timestampMs / resolution * resolution)];
+            const int values[MonitorRollups::VitalCount] = {m.heartRate, m.spo2, m.resp};
+
+            ++bucket.count;
+            for (int v = 0; v < MonitorRollups::VitalCount; ++v) {
+                if (m.valid & validBits[v])
+                    bucket.vitals[v].add(values[v]);
+            }
+        }
+
+        QSqlQuery &query = m_statements.statement(m_rollupSql[l]);
+        for (auto it = buckets.cbegin(); it != buckets.cend(); ++it) {
+            query.bindValue(":pid", it.key().first);
+            query.bindValue(":bucket", it.key().second);
+            query.bindValue(":count", it->count);
+
+            for (int v = 0; v < MonitorRollups::VitalCount; ++v) {
+                const MonitorRollups::Bucket::Vital &vital = it->vitals[v];
+                const QString prefix = QLatin1Char(':') + QLatin1String(MonitorRollups::Vitals[v]);
+                query.bindValue(prefix + "_count", vital.count);
+                query.bindValue(prefix + "_min", vital.count ? QVariant(vital.min) : null);
+                query.bindValue(prefix + "_max", vital.count ? QVariant(vital.max) : null);
+                query.bindValue(prefix + "_sum", vital.sum);
+            }
+
+            if (!query.exec()) {
+                qWarning() << "Failed to update" << MonitorRollups::Levels[l].table << ":" << query.lastError().text();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void MeasurementWriter::close()
+{
+    // One last attempt; whatever still fails is lost with the process
+    flush();
+    if (queueDepth() > 0)
+        qWarning() << "Measurement writer closing with" << queueDepth() << "unwritten rows";
+    m_flushTimer->stop();
+    m_statements.clear();
+    {
+        QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+        if (db.isValid())
+            db.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
@@ -0,0 +1,96 @@
+#ifndef MEASUREMENTWRITER_H
+#define MEASUREMENTWRITER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+#include <QSqlDatabase>
+#include <QTimer>
+#include <atomic>
+#include "sqlstatementcache.h"
+
+// Write-behind store for monitor_data rows.
+// enqueue() only appends to an in-memory queue; the writer lives on its own
+// thread with its own SQLite connection and commits the queue in batched
+// transactions, either when MaxBatchSize rows are pending or at the latest
+// MaxFlushLatencyMs after the first pending row. The trend rollups are
+// updated in the same transaction (see MonitorRollups).
+//
+// A batch that fails (e.g. SQLITE_BUSY past the busy timeout) goes back to
+// the front of the queue and is retried with a doubling delay of up to
+// MaxRetryDelayMs. While the database stays unavailable the queue is capped
+// at MaxPendingRows; the oldest rows beyond that are dropped and counted.
+class MeasurementWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Bits of monitor_data.valid
+    enum Validity {
+        HeartRateValid = 0x1,
+        Spo2Valid = 0x2,
+        RespValid = 0x4
+    };
+
+    struct Measurement
+    {
+        QString patientId;
+        qint64 timestampMs = 0;
+        int heartRate = 0;
+        int spo2 = 0;
+        int resp = 0;
+        int valid = 0; // Validity bits
+    };
+
+    static constexpr int MaxBatchSize = 64;
+    static constexpr int MaxFlushLatencyMs = 500;
+    static constexpr int MaxRetryDelayMs = 16000;
+    static constexpr int MaxPendingRows = 20000;
+
+    explicit MeasurementWriter(const QString &databasePath, QObject *parent = nullptr);
+
+    // Thread-safe, never touches the database
+    void enqueue(const Measurement &measurement);
+
+    // Metrics, readable from any thread
+    int queueDepth() const { return m_queueDepth.load(std::memory_order_relaxed); }
+    double lastCommitMs() const { return m_lastCommitUs.load(std::memory_order_relaxed) / 1000.0; }
+    double maxCommitMs() const { return m_maxCommitUs.load(std::memory_order_relaxed) / 1000.0; }
+    quint64 committedRows() const { return m_committedRows.load(std::memory_order_relaxed); }
+    quint64 failedBatches() const { return m_failedBatches.load(std::memory_order_relaxed); }
+    quint64 droppedRows() const { return m_droppedRows.load(std::memory_order_relaxed); }
+
+public slots:
+
+    // Must run on the writer thread
+    void open();
+    void flush();
+    void close();
+
+private:
+    bool writeBatch();
+    bool updateRollups();
+    void requeueBatch();
+
+    QString m_databasePath;
+    QString m_connectionName;
+    QTimer *m_flushTimer;
+    SqlStatementCache m_statements; // Owned by the writer connection
+    QStringList m_rollupSql;        // Upsert per MonitorRollups level
+
+    QMutex m_mutex;
+    QVector<Measurement> m_pending;
+    QVector<Measurement> m_batch; // Swapped with m_pending on flush, reused
+    int m_retryDelayMs = 0;       // Writer thread; 0 while batches succeed
+    std::atomic_bool m_retrying{false};
+
+    std::atomic<int> m_queueDepth{0};
+    std::atomic<qint64> m_lastCommitUs{0};
+    std::atomic<qint64> m_maxCommitUs{0};
+    std::atomic<quint64> m_committedRows{0};
+    std::atomic<quint64> m_failedBatches{0};
+    std::atomic<quint64> m_droppedRows{0};
+};
+
+#endif // MEASUREMENTWRITER_H
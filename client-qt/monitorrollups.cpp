@@ -0,0 +1,75 @@
+#include "monitorrollups.h"
+
+#include <QStringList>
+
+namespace MonitorRollups {
+
+const Level *coarsestFor(qint64 bucketMs)
+{
+    for (int i = LevelCount - 1; i >= 0; --i) {
+        if (Levels[i].resolutionMs <= bucketMs)
+            return &Levels[i];
+    }
+    return nullptr;
+}
+
+QString createTableSql(const Level &level)
+{
+    QStringList columns;
+    for (const char *vital : Vitals) {
+        columns << QString("%1_count INTEGER NOT NULL DEFAULT 0").arg(vital)
+                << QString("%1_min INTEGER").arg(vital)
+                << QString("%1_max INTEGER").arg(vital)
+                << QString("%1_sum INTEGER NOT NULL DEFAULT 0").arg(vital);
+    }
+
+    return QString(R"(
+        CREATE TABLE IF NOT EXISTS %1 (
+            patient_id TEXT NOT NULL,
+            bucket_ms INTEGER NOT NULL,
+            count INTEGER NOT NULL,
+            %2,
+            PRIMARY KEY (patient_id, bucket_ms)
+        ) WITHOUT ROWID
+    )").arg(level.table, columns.join(",\n            "));
+}
+
+QString rebuildSql(const Level &level)
+{
+    QStringList columns;
+    QStringList aggregates;
+    for (const char *vital : Vitals) {
+        columns << QString("%1_count, %1_min, %1_max, %1_sum").arg(vital);
+        aggregates << QString("COUNT(%1), MIN(%1), MAX(%1), COALESCE(SUM(%1), 0)").arg(vital);
+    }
+
+    return QString(R"(
+        INSERT INTO %1 (patient_id, bucket_ms, count, %2)
+        SELECT patient_id, (timestamp_ms / %3) * %3, COUNT(*), %4
+        FROM monitor_data
+        WHERE timestamp_ms >= :start
+        GROUP BY patient_id, timestamp_ms / %3
+    )").arg(level.table, columns.join(", ")).arg(level.resolutionMs).arg(aggregates.join(", "));
+}
+
+QString upsertSql(const Level &level)
+{
+    QStringList columns;
+    QStringList values;
+    QStringList updates;
+    for (const char *vital : Vitals) {
+        columns << QString("%1_count, %1_min, %1_max, %1_sum").arg(vital);
+        values << QString(":%1_count, :%1_min, :%1_max, :%1_sum").arg(vital);
+        // Scalar MIN/MAX return NULL if either side is NULL, hence the COALESCEs
+        updates << QString("%1_count = %1_count + excluded.%1_count").arg(vital)
+                << QString("%1_min = MIN(COALESCE(%1_min, excluded.%1_min), COALESCE(excluded.%1_min, %1_min))").arg(vital)
+                << QString("%1_max = MAX(COALESCE(%1_max, excluded.%1_max), COALESCE(excluded.%1_max, %1_max))").arg(vital)
+                << QString("%1_sum = %1_sum + excluded.%1_sum").arg(vital);
+    }
+
+    return QString("INSERT INTO %1 (patient_id, bucket_ms, count, %2) "
+                   "VALUES (:pid, :bucket, :count, %3) "
+                   "ON CONFLICT (patient_id, bucket_ms) DO UPDATE SET count = count + excluded.count, %4")
+        .arg(level.table, columns.join(", "), values.join(", "), updates.join(", "));
+}
+}
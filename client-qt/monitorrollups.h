@@ -0,0 +1,71 @@
+#ifndef MONITORROLLUPS_H
+#define MONITORROLLUPS_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Per-patient trend rollups of monitor_data at fixed resolutions.
+// Each table holds one row per (patient_id, bucket_ms) with the reading
+// count and, per vital, the count of valid readings and their min, max and
+// sum (the mean is sum / count). The measurement writer folds every batch
+// into all levels in the same transaction as the raw rows, so the rollups
+// never lag behind monitor_data.
+namespace MonitorRollups {
+
+struct Level
+{
+    const char *table;
+    qint64 resolutionMs;
+};
+
+// Finest first
+constexpr int LevelCount = 3;
+inline constexpr Level Levels[LevelCount] = {
+    {"monitor_rollup_1m", 60 * 1000},
+    {"monitor_rollup_15m", 15 * 60 * 1000},
+    {"monitor_rollup_1h", 60 * 60 * 1000}
+};
+
+// Vital columns in monitor_data order; rollup columns are <vital>_count etc.
+constexpr int VitalCount = 3;
+inline constexpr const char *Vitals[VitalCount] = {"heartRate", "spo2", "resp"};
+
+// Coarsest level with at least one row per bucketMs, or nullptr if even
+// the finest one is too coarse and the raw rows must be read
+const Level *coarsestFor(qint64 bucketMs);
+
+QString createTableSql(const Level &level);
+
+// Recomputes a level from the monitor_data rows at or after :start (after
+// deleting its rows from :start on)
+QString rebuildSql(const Level &level);
+
+// Merges one pre-aggregated bucket; binds :pid, :bucket, :count and
+// :<vital>_count, :<vital>_min, :<vital>_max, :<vital>_sum
+QString upsertSql(const Level &level);
+
+// Accumulates readings of one bucket before it is upserted
+struct Bucket
+{
+    struct Vital
+    {
+        int count = 0;
+        int min = 0;
+        int max = 0;
+        qint64 sum = 0;
+
+        void add(int value)
+        {
+            min = count ? qMin(min, value) : value;
+            max = count ? qMax(max, value) : value;
+            sum += value;
+            ++count;
+        }
+    };
+
+    int count = 0;
+    Vital vitals[VitalCount];
+};
+}
+
+#endif // MONITORROLLUPS_H
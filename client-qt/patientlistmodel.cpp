@@ -0,0 +1,84 @@
+#include "patientlistmodel.h"
+
+PatientListModel::PatientListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{}
+
+int PatientListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : count();
+}
+
+QVariant PatientListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+
+    const databaseClass::PatientRecord &patient = m_rows.at(index.row());
+    switch (role) {
+    case PatientIdRole: return patient.patientId;
+    case Qt::DisplayRole:
+    case NameRole: return patient.name;
+    case SurnameRole: return patient.surname;
+    case TcRole: return patient.tc;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> PatientListModel::roleNames() const
+{
+    return {
+        {PatientIdRole, "patient_id"},
+        {NameRole, "name"},
+        {SurnameRole, "surname"},
+        {TcRole, "tc"}
+    };
+}
+
+bool PatientListModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !m_atEnd;
+}
+
+void PatientListModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+
+    const QVector<databaseClass::PatientRecord> page = databaseClass::instance()->getPatientPage(
+        m_rows.isEmpty() ? nullptr : &m_rows.constLast(), PageSize);
+    m_atEnd = page.size() < PageSize;
+    if (page.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), count(), count() + int(page.size()) - 1);
+    m_rows += page;
+    endInsertRows();
+    emit countChanged();
+}
+
+void PatientListModel::setFilter(const QString &filter)
+{
+    if (m_filter == filter)
+        return;
+
+    m_filter = filter;
+    reload();
+    emit filterChanged();
+}
+
+void PatientListModel::reload()
+{
+    beginResetModel();
+    m_rows.clear();
+    m_rows.squeeze();
+    m_atEnd = false;
+
+    // Search results come in one go, there are no further pages
+    if (!m_filter.trimmed().isEmpty()) {
+        m_rows = databaseClass::instance()->searchPatients(m_filter, SearchLimit);
+        m_atEnd = true;
+    }
+    endResetModel();
+    emit countChanged();
+}
@@ -0,0 +1,60 @@
+#ifndef PATIENTLISTMODEL_H
+#define PATIENTLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include "database.h"
+
+// Patient list for QML, loaded a page at a time as the view scrolls.
+// Pages are keyset queries continuing after the last loaded patient (see
+// databaseClass::getPatientPage), so opening the list costs one page no
+// matter how many patients are registered. With a filter set the model
+// holds the best SearchLimit matches of the search index instead. Roles
+// match the columns: patient_id, name, surname and tc.
+class PatientListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(QString filter READ filter WRITE setFilter NOTIFY filterChanged)
+
+public:
+    enum Roles {
+        PatientIdRole = Qt::UserRole + 1,
+        NameRole,
+        SurnameRole,
+        TcRole
+    };
+
+    static constexpr int PageSize = 50;
+    static constexpr int SearchLimit = 200;
+
+    explicit PatientListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    int count() const { return int(m_rows.size()); }
+
+    // Search-as-you-type text; empty lists every patient
+    QString filter() const { return m_filter; }
+    void setFilter(const QString &filter);
+
+    // Drops the loaded rows; the view fetches the first page again,
+    // or the filter is searched again
+    Q_INVOKABLE void reload();
+
+signals:
+    void countChanged();
+    void filterChanged();
+
+private:
+    QString m_filter;
+    QVector<databaseClass::PatientRecord> m_rows;
+    bool m_atEnd = false;
+};
+
+#endif // PATIENTLISTMODEL_H
@@ -0,0 +1,134 @@
+#include "patientsearchindex.h"
+#include <QSet>
+#include <QStringList>
+#include <algorithm>
+
+// Leading space so that every word, the first included, follows a space
+static QString searchText(const PatientSearchIndex::Patient &patient)
+{
+    return QStringLiteral(" %1 %2 %3").arg(patient.name, patient.surname, patient.tc);
+}
+
+QString PatientSearchIndex::fold(QStringView text)
+{
+    QString folded;
+    folded.reserve(text.size());
+    for (QChar c : text) {
+        if (c == u'I')
+            folded += u'ı';
+        else if (c == u'İ')
+            folded += u'i';
+        else if (c.isSpace())
+            folded += u' ';
+        else
+            folded += c.toLower();
+    }
+    return folded;
+}
+
+void PatientSearchIndex::clear()
+{
+    m_patients.clear();
+    m_entries.clear();
+}
+
+void PatientSearchIndex::reserve(int patients)
+{
+    m_patients.reserve(patients);
+    m_entries.reserve(size_t(patients) * 3);
+}
+
+QStringView PatientSearchIndex::key(const Entry &entry) const
+{
+    return QStringView(m_patients[entry.patient].folded).mid(entry.offset);
+}
+
+void PatientSearchIndex::appendEntries(quint32 patient, std::vector<Entry> &entries) const
+{
+    const QString &folded = m_patients[patient].folded;
+    for (qsizetype i = 1; i < folded.size(); ++i) {
+        if (folded.at(i - 1) == u' ' && folded.at(i) != u' ')
+            entries.push_back({patient, quint32(i)});
+    }
+}
+
+void PatientSearchIndex::load(const Patient &patient)
+{
+    m_patients.push_back({patient, fold(searchText(patient))});
+    appendEntries(quint32(m_patients.size() - 1), m_entries);
+}
+
+void PatientSearchIndex::finishLoad()
+{
+    std::sort(m_entries.begin(), m_entries.end(), [this](const Entry &a, const Entry &b) {
+        return key(a) < key(b);
+    });
+}
+
+void PatientSearchIndex::insert(const Patient &patient)
+{
+    m_patients.push_back({patient, fold(searchText(patient))});
+
+    std::vector<Entry> added;
+    appendEntries(quint32(m_patients.size() - 1), added);
+    for (const Entry &entry : added) {
+        const QStringView text = key(entry);
+        auto position = std::upper_bound(m_entries.begin(), m_entries.end(), text,
+                                         [this](QStringView value, const Entry &e) { return value < key(e); });
+        m_entries.insert(position, entry);
+    }
+}
+
+std::pair<std::vector<PatientSearchIndex::Entry>::const_iterator, std::vector<PatientSearchIndex::Entry>::const_iterator>
+PatientSearchIndex::range(QStringView prefix) const
+{
+    // Keys starting with prefix sort right after prefix itself and before
+    // any key whose first prefix.size() characters compare greater
+    auto first = std::lower_bound(m_entries.cbegin(), m_entries.cend(), prefix,
+                                  [this](const Entry &e, QStringView value) { return key(e) < value; });
+    auto last = std::partition_point(first, m_entries.cend(), [this, prefix](const Entry &e) {
+        return key(e).startsWith(prefix);
+    });
+    return {first, last};
+}
+
+QVector<int> PatientSearchIndex::search(const QString &query, int limit) const
+{
+    QVector<int> matches;
+    const QStringList words = fold(query).split(u' ', Qt::SkipEmptyParts);
+    if (words.isEmpty() || limit <= 0)
+        return matches;
+
+    // Enumerate the word with the fewest index entries
+    int pivot = 0;
+    auto best = range(words.first());
+    for (int i = 1; i < words.size(); ++i) {
+        auto candidate = range(words.at(i));
+        if (candidate.second - candidate.first < best.second - best.first) {
+            best = candidate;
+            pivot = i;
+        }
+    }
+
+    QStringList others;
+    for (int i = 0; i < words.size(); ++i) {
+        if (i != pivot)
+            others.append(QStringLiteral(" ") + words.at(i));
+    }
+
+    // A patient with two matching words has two entries in the run
+    QSet<quint32> seen;
+    for (auto it = best.first; it != best.second && matches.size() < limit; ++it) {
+        if (seen.contains(it->patient))
+            continue;
+        seen.insert(it->patient);
+
+        const QString &folded = m_patients[it->patient].folded;
+        const bool all = std::all_of(others.cbegin(), others.cend(), [&folded](const QString &word) {
+            return folded.contains(word);
+        });
+        if (all)
+            matches.append(int(it->patient));
+    }
+    return matches;
+}
@@ -0,0 +1,72 @@
+#ifndef PATIENTSEARCHINDEX_H
+#define PATIENTSEARCHINDEX_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <vector>
+
+// In-memory search-as-you-type index over the patients' name, surname and TC.
+//
+// Every patient keeps one folded copy of " name surname tc" (Turkish case
+// folding, see fold()). The index is a sorted array of (patient, offset)
+// entries, one per word start in that copy, ordered by the text from the
+// offset on; an entry is 8 bytes and no key strings are stored. All words
+// starting with a prefix form one contiguous run, found with two binary
+// searches. A query of several words is answered from the word with the
+// shortest run; the other words are checked against each candidate's folded
+// copy, so short first words do not make a query slower.
+//
+// Not thread-safe; used from the thread that owns the database connection.
+class PatientSearchIndex
+{
+public:
+    struct Patient
+    {
+        QString patientId;
+        QString name;
+        QString surname;
+        QString tc;
+    };
+
+    // Bulk load: appends without sorting, then sorts once in finishLoad()
+    void clear();
+    void reserve(int patients);
+    void load(const Patient &patient);
+    void finishLoad();
+
+    // Keeps the index sorted; for patients added after the bulk load
+    void insert(const Patient &patient);
+
+    // Patients with a word starting with every word of query, at most limit,
+    // in the order of the most selective query word
+    QVector<int> search(const QString &query, int limit) const;
+
+    const Patient &patient(int index) const { return m_patients.at(index).patient; }
+    int size() const { return int(m_patients.size()); }
+
+    // Turkish lower case ('I' -> 'ı', 'İ' -> 'i'), all white space as ' '
+    static QString fold(QStringView text);
+
+private:
+    struct Entry
+    {
+        quint32 patient;
+        quint32 offset;
+    };
+
+    struct Record
+    {
+        Patient patient;
+        QString folded; // " name surname tc", folded
+    };
+
+    QStringView key(const Entry &entry) const;
+    void appendEntries(quint32 patient, std::vector<Entry> &entries) const;
+    std::pair<std::vector<Entry>::const_iterator, std::vector<Entry>::const_iterator> range(QStringView prefix) const;
+
+    std::vector<Record> m_patients;
+    std::vector<Entry> m_entries;
+};
+
+#endif // PATIENTSEARCHINDEX_H
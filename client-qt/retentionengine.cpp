@@ -0,0 +1,265 @@
+#include "retentionengine.h"
+#include "monitorrollups.h"
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <limits>
+
+namespace {
+constexpr qint64 DayMs = 24 * 60 * 60 * 1000LL;
+constexpr int StartupDelayMs = 60 * 1000; // Keep the first pass out of the way of startup
+}
+
+RetentionEngine::RetentionEngine(const QString &databasePath, QObject *parent)
+    : QObject(parent), m_databasePath(databasePath),
+      m_connectionName(QStringLiteral("retention"))
+{
+    m_passTimer = new QTimer(this);
+    m_passTimer->setInterval(m_policy.passIntervalMs);
+    connect(m_passTimer, &QTimer::timeout, this, &RetentionEngine::runPass);
+
+    m_stepTimer = new QTimer(this);
+    m_stepTimer->setSingleShot(true);
+    connect(m_stepTimer, &QTimer::timeout, this, &RetentionEngine::step);
+}
+
+void RetentionEngine::setPolicy(const Policy &policy)
+{
+    m_policy = policy;
+    m_policy.rawDays = qMax(1, m_policy.rawDays);
+    m_policy.minuteRollupDays = qMax(m_policy.rawDays, m_policy.minuteRollupDays);
+    m_policy.batchRows = qMax(1, m_policy.batchRows);
+    m_policy.vacuumPagesPerStep = qMax(1, m_policy.vacuumPagesPerStep);
+    m_passTimer->setInterval(m_policy.passIntervalMs);
+}
+
+void RetentionEngine::open()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_databasePath);
+
+    if (!db.open()) {
+        qWarning() << "Retention engine could not open database:" << db.lastError().text();
+        return;
+    }
+
+    QSqlQuery pragma(db);
+    pragma.exec("PRAGMA busy_timeout=2000");
+    pragma.exec("PRAGMA auto_vacuum");
+    m_incrementalVacuum = pragma.next() && pragma.value(0).toInt() == 2;
+    if (!m_incrementalVacuum)
+        qDebug() << "Retention engine: incremental auto-vacuum is off, converting before the first pass";
+
+    m_statements.setDatabase(db);
+    m_passTimer->start();
+    QTimer::singleShot(StartupDelayMs, this, &RetentionEngine::runPass);
+
+    qDebug() << "Retention engine ready, raw rows kept for" << m_policy.rawDays << "days.";
+}
+
+void RetentionEngine::runPass()
+{
+    if (m_phase != Idle || !QSqlDatabase::database(m_connectionName, false).isOpen())
+        return;
+
+    if (!m_incrementalVacuum && !m_conversionTried)
+        convertToIncrementalVacuum();
+
+    // Cut on an hour boundary, so the remaining raw rows start on a bucket
+    // boundary of every rollup level and a rollup rebuild stays exact
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 align = MonitorRollups::Levels[MonitorRollups::LevelCount - 1].resolutionMs;
+    m_rawCutoffMs = (now - m_policy.rawDays * DayMs) / align * align;
+    m_rollupCutoffMs = (now - m_policy.minuteRollupDays * DayMs) / align * align;
+
+    m_passStartMs = now;
+    m_lastFreePages = std::numeric_limits<int>::max();
+    m_rollupPatientId.clear();
+    m_phase = RawRows;
+    step();
+}
+
+void RetentionEngine::convertToIncrementalVacuum()
+{
+    m_conversionTried = true;
+
+    // VACUUM builds the new file next to the old one
+    const qint64 size = QFileInfo(m_databasePath).size();
+    const QStorageInfo storage(QFileInfo(m_databasePath).absolutePath());
+    if (storage.bytesAvailable() < 2 * size) {
+        qWarning() << "Retention engine: not enough disk space to convert to incremental auto-vacuum,"
+                   << "freed pages stay in the file";
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.exec("PRAGMA auto_vacuum=INCREMENTAL");
+    if (!query.exec("VACUUM")) {
+        qWarning() << "Retention engine: VACUUM failed:" << query.lastError().text();
+        return;
+    }
+
+    query.exec("PRAGMA auto_vacuum");
+    m_incrementalVacuum = query.next() && query.value(0).toInt() == 2;
+    qDebug() << "Converted to incremental auto-vacuum in" << timer.elapsed() << "ms";
+}
+
+void RetentionEngine::step()
+{
+    switch (m_phase) {
+    case Idle:
+        return;
+
+    case RawRows: {
+        // A range seek on idx_monitor_data_time; a pass with nothing left
+        // to delete touches a single index entry
+        const int deleted = deleteBatch("DELETE FROM monitor_data WHERE id IN "
+                                        "(SELECT id FROM monitor_data WHERE timestamp_ms < :cutoff "
+                                        "ORDER BY timestamp_ms LIMIT :limit)", m_rawCutoffMs);
+        if (deleted < 0) {
+            m_phase = Idle;
+            return;
+        }
+        if (deleted < m_policy.batchRows)
+            m_phase = MinuteRollups;
+        break;
+    }
+
+    case MinuteRollups: {
+        // bucket_ms is the second primary key column, so the rows are
+        // deleted one patient at a time as ranges of the key prefix
+        if (m_rollupPatientId.isEmpty() && !nextRollupPatient()) {
+            m_phase = m_incrementalVacuum ? Vacuum : Idle;
+            break;
+        }
+
+        const int deleted = deleteBatch(QString("DELETE FROM %1 WHERE (patient_id, bucket_ms) IN "
+                                                "(SELECT patient_id, bucket_ms FROM %1 WHERE patient_id = :pid AND bucket_ms < :cutoff "
+                                                "ORDER BY bucket_ms LIMIT :limit)").arg(MonitorRollups::Levels[0].table),
+                                        m_rollupCutoffMs, m_rollupPatientId);
+        if (deleted < 0) {
+            m_phase = Idle;
+            return;
+        }
+        if (deleted < m_policy.batchRows && !nextRollupPatient())
+            m_phase = m_incrementalVacuum ? Vacuum : Idle;
+        break;
+    }
+
+    case Vacuum: {
+        QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+        QSqlQuery query(db);
+        query.exec("PRAGMA freelist_count");
+        const int freePages = query.next() ? query.value(0).toInt() : 0;
+        query.finish();
+
+        // Stop once nothing is left, or if the previous step freed nothing
+        if (freePages == 0 || freePages >= m_lastFreePages) {
+            m_phase = Idle;
+            break;
+        }
+        m_lastFreePages = freePages;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // SQLite frees one page per step of this pragma and QSqlQuery steps
+        // once per exec(), so it is executed once per page, in one transaction
+        const int pages = qMin(freePages, m_policy.vacuumPagesPerStep);
+        QSqlQuery &vacuum = m_statements.statement("PRAGMA incremental_vacuum");
+
+        db.transaction();
+        bool ok = true;
+        for (int i = 0; i < pages && ok; ++i)
+            ok = vacuum.exec();
+        vacuum.finish();
+
+        if (!ok || !db.commit()) {
+            qWarning() << "Incremental vacuum failed:" << vacuum.lastError().text();
+            db.rollback();
+            m_phase = Idle;
+            break;
+        }
+
+        m_vacuumedPages.fetch_add(quint64(pages), std::memory_order_relaxed);
+        const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+        if (elapsedUs > m_maxBatchUs.load(std::memory_order_relaxed))
+            m_maxBatchUs.store(elapsedUs, std::memory_order_relaxed);
+        break;
+    }
+    }
+
+    if (m_phase == Idle) {
+        QSqlQuery(QSqlDatabase::database(m_connectionName, false)).exec("PRAGMA optimize");
+        const qint64 elapsed = QDateTime::currentMSecsSinceEpoch() - m_passStartMs;
+        m_lastPassMs.store(double(elapsed), std::memory_order_relaxed);
+        qDebug() << "Retention pass finished in" << elapsed << "ms," << deletedRows() << "rows and"
+                 << vacuumedPages() << "pages reclaimed so far";
+        return;
+    }
+
+    // Pause between batches so the writer gets the lock
+    m_stepTimer->start(m_policy.batchPauseMs);
+}
+
+// Advances to the next patient with minute rollups by seeking the primary
+// key past the current one; false once all patients are done
+bool RetentionEngine::nextRollupPatient()
+{
+    QSqlQuery &query = m_statements.statement(QString("SELECT patient_id FROM %1 WHERE patient_id > :pid "
+                                                      "ORDER BY patient_id LIMIT 1").arg(MonitorRollups::Levels[0].table));
+    query.bindValue(":pid", m_rollupPatientId);
+    const bool found = query.exec() && query.next();
+    m_rollupPatientId = found ? query.value(0).toString() : QString();
+    query.finish();
+    return found;
+}
+
+// One autocommit DELETE; returns the number of rows removed or -1
+int RetentionEngine::deleteBatch(const QString &sql, qint64 cutoffMs, const QString &patientId)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QSqlQuery &query = m_statements.statement(sql);
+    if (!patientId.isEmpty())
+        query.bindValue(":pid", patientId);
+    query.bindValue(":cutoff", cutoffMs);
+    query.bindValue(":limit", m_policy.batchRows);
+
+    if (!query.exec()) {
+        qWarning() << "Retention delete failed:" << query.lastError().text();
+        return -1;
+    }
+
+    const int deleted = query.numRowsAffected();
+    m_deletedRows.fetch_add(quint64(qMax(0, deleted)), std::memory_order_relaxed);
+
+    const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+    if (elapsedUs > m_maxBatchUs.load(std::memory_order_relaxed))
+        m_maxBatchUs.store(elapsedUs, std::memory_order_relaxed);
+    return deleted;
+}
+
+void RetentionEngine::close()
+{
+    m_passTimer->stop();
+    m_stepTimer->stop();
+    m_phase = Idle;
+    m_statements.clear();
+    {
+        QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+        if (db.isValid())
+            db.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
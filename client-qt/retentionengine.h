@@ -0,0 +1,84 @@
+#ifndef RETENTIONENGINE_H
+#define RETENTIONENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <atomic>
+#include "sqlstatementcache.h"
+
+// Ages out old vitals on its own thread and SQLite connection.
+// A pass deletes monitor_data rows older than rawDays and minute rollups
+// older than minuteRollupDays (the coarser rollups are kept), in batches of
+// batchRows, each in its own short transaction with batchPauseMs between
+// them so the measurement writer is never locked out for long. It then
+// returns the freed pages to the file system with incremental vacuum steps.
+// Rollups are maintained on insert, so nothing is lost from the trends.
+//
+// A database created before incremental auto-vacuum was used is converted
+// with a one-time VACUUM before the first pass, on this thread. VACUUM
+// rewrites the whole file and blocks the writer until it is done (the
+// writer retries), so it is skipped if the disk cannot hold a second copy.
+class RetentionEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Policy
+    {
+        int rawDays = 7;
+        int minuteRollupDays = 90;
+        int batchRows = 1000;
+        int batchPauseMs = 50;
+        int vacuumPagesPerStep = 256;
+        int passIntervalMs = 60 * 60 * 1000;
+    };
+
+    explicit RetentionEngine(const QString &databasePath, QObject *parent = nullptr);
+
+    // Metrics, readable from any thread
+    quint64 deletedRows() const { return m_deletedRows.load(std::memory_order_relaxed); }
+    quint64 vacuumedPages() const { return m_vacuumedPages.load(std::memory_order_relaxed); }
+    double lastPassMs() const { return m_lastPassMs.load(std::memory_order_relaxed); }
+    double maxBatchMs() const { return m_maxBatchUs.load(std::memory_order_relaxed) / 1000.0; }
+
+    // Must run on the retention thread, like the slots
+    void setPolicy(const Policy &policy);
+
+public slots:
+
+    void open();
+    void runPass();
+    void close();
+
+private:
+    enum Phase { Idle, RawRows, MinuteRollups, Vacuum };
+
+    void step();
+    void convertToIncrementalVacuum();
+    int deleteBatch(const QString &sql, qint64 cutoffMs, const QString &patientId = QString());
+    bool nextRollupPatient();
+
+    QString m_databasePath;
+    QString m_connectionName;
+    SqlStatementCache m_statements;
+    Policy m_policy;
+    bool m_incrementalVacuum = false;
+    bool m_conversionTried = false;
+    QTimer *m_passTimer;
+    QTimer *m_stepTimer;
+
+    Phase m_phase = Idle;
+    qint64 m_rawCutoffMs = 0;
+    qint64 m_rollupCutoffMs = 0;
+    QString m_rollupPatientId; // Patient whose minute rollups are being aged out
+    qint64 m_passStartMs = 0;
+    int m_lastFreePages = 0;
+
+    std::atomic<quint64> m_deletedRows{0};
+    std::atomic<quint64> m_vacuumedPages{0};
+    std::atomic<double> m_lastPassMs{0};
+    std::atomic<qint64> m_maxBatchUs{0};
+};
+
+#endif // RETENTIONENGINE_H
@@ -0,0 +1,213 @@
+#include "smmcapture.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+
+static const char Magic[8] = {'S', 'M', 'M', 'C', 'A', 'P', '0', '1'};
+static constexpr qint64 HeaderSize = sizeof(Magic) + sizeof(qint64);
+
+static int writeVarint(quint64 value, char *out)
+{
+    int size = 0;
+    while (value >= 0x80) {
+        out[size++] = char(value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = char(value);
+    return size;
+}
+
+// Returns false if the varint runs past end
+static bool readVarint(const uchar *&in, const uchar *end, quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        const uchar byte = *in++;
+        value |= quint64(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool SMMCaptureWriter::open(const QString &path)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot open capture file" << path << ":" << m_file.errorString();
+        return false;
+    }
+
+    char header[HeaderSize];
+    memcpy(header, Magic, sizeof(Magic));
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + sizeof(Magic));
+    m_file.write(header, HeaderSize);
+
+    m_clock.start();
+    m_lastUs = 0;
+    m_bytesCaptured = 0;
+    qDebug() << "Capturing the SMM link to" << path;
+    return true;
+}
+
+void SMMCaptureWriter::close()
+{
+    if (!m_file.isOpen())
+        return;
+
+    m_file.close();
+    qDebug() << "Capture closed:" << m_file.fileName() << m_bytesCaptured << "bytes";
+}
+
+void SMMCaptureWriter::write(const char *data, qint64 size)
+{
+    if (!m_file.isOpen() || size <= 0)
+        return;
+
+    const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+    char header[20];
+    int headerSize = writeVarint(quint64(nowUs - m_lastUs), header);
+    headerSize += writeVarint(quint64(size), header + headerSize);
+    m_lastUs = nowUs;
+
+    // QFile buffers, so a read costs a copy here and a syscall now and then
+    if (m_file.write(header, headerSize) != headerSize || m_file.write(data, size) != size) {
+        qWarning() << "Capture write failed, stopping:" << m_file.errorString();
+        close();
+        return;
+    }
+    m_bytesCaptured += size;
+}
+
+bool SMMCaptureReader::open(const QString &path, QString *error)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        if (error)
+            *error = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_data = m_size >= HeaderSize ? m_file.map(0, m_size) : nullptr;
+    if (!m_data || memcmp(m_data, Magic, sizeof(Magic)) != 0) {
+        if (error)
+            *error = QString("%1 is not an SMM capture").arg(path);
+        close();
+        return false;
+    }
+
+    m_startMs = qFromLittleEndian<qint64>(m_data + sizeof(Magic));
+    rewind();
+    return true;
+}
+
+void SMMCaptureReader::close()
+{
+    if (m_data)
+        m_file.unmap(const_cast<uchar *>(m_data));
+    m_data = nullptr;
+    m_size = 0;
+    m_file.close();
+}
+
+void SMMCaptureReader::rewind()
+{
+    m_pos = HeaderSize;
+    m_timeUs = 0;
+}
+
+bool SMMCaptureReader::next(Chunk &chunk)
+{
+    if (!m_data)
+        return false;
+
+    const uchar *in = m_data + m_pos;
+    const uchar *end = m_data + m_size;
+    quint64 deltaUs = 0;
+    quint64 size = 0;
+    if (!readVarint(in, end, deltaUs) || !readVarint(in, end, size) || size > quint64(end - in))
+        return false;
+
+    m_timeUs += qint64(deltaUs);
+    chunk.timeUs = m_timeUs;
+    chunk.data = QByteArrayView(reinterpret_cast<const char *>(in), qsizetype(size));
+    m_pos = (in - m_data) + qint64(size);
+    return true;
+}
+
+SMMCaptureReplay::SMMCaptureReplay(QObject *parent) : QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &SMMCaptureReplay::feed);
+}
+
+bool SMMCaptureReplay::start(const QString &path, double speed, QString *error)
+{
+    stop();
+
+    if (!m_reader.open(path, error))
+        return false;
+
+    m_speed = qMax(0.0, speed);
+    m_hasPending = false;
+    m_bytesReplayed = 0;
+    m_chunksReplayed = 0;
+    m_elapsedMs = 0;
+    m_clock.start();
+    m_timer->start(0);
+    return true;
+}
+
+void SMMCaptureReplay::stop()
+{
+    if (!m_reader.isOpen())
+        return;
+
+    m_timer->stop();
+    m_elapsedMs = m_clock.elapsed();
+    m_hasPending = false;
+    m_reader.close();
+    emit finished();
+}
+
+void SMMCaptureReplay::feed()
+{
+    const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+    qint64 batchBytes = 0;
+
+    for (;;) {
+        if (!m_hasPending) {
+            if (!m_reader.next(m_pending)) {
+                stop();
+                return;
+            }
+            m_hasPending = true;
+        }
+
+        if (m_speed > 0) {
+            const qint64 dueUs = qint64(m_pending.timeUs / m_speed);
+            if (dueUs > nowUs) {
+                m_timer->start(int((dueUs - nowUs + 999) / 1000));
+                return;
+            }
+        } else if (batchBytes >= MaxBatchBytes) {
+            m_timer->start(0);
+            return;
+        }
+
+        if (m_sink)
+            m_sink(m_pending.data);
+        batchBytes += m_pending.data.size();
+        m_bytesReplayed += quint64(m_pending.data.size());
+        ++m_chunksReplayed;
+        m_hasPending = false;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef SMMCAPTURE_H
+#define SMMCAPTURE_H
+
+#include <QByteArrayView>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <functional>
+
+// Raw serial captures of an SMM link, for reproducing field issues and for
+// measuring the parser against real traffic offline.
+//
+// A capture holds the bytes exactly as they were read from the port, one
+// record per read: the 8-byte magic "SMMCAP01" and the wall-clock start
+// time (int64 ms, little endian), then per record the microseconds since
+// the previous record and the chunk length as base-128 varints, followed by
+// the raw bytes. Times come from a monotonic clock. A capture cut short by
+// a crash is readable up to its last complete record.
+class SMMCaptureWriter
+{
+public:
+    ~SMMCaptureWriter() { close(); }
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+    QString fileName() const { return m_file.fileName(); }
+    qint64 bytesCaptured() const { return m_bytesCaptured; }
+
+    // Appends one chunk as read from the port, stamped with the current time
+    void write(const char *data, qint64 size);
+
+private:
+    QFile m_file;
+    QElapsedTimer m_clock;
+    qint64 m_lastUs = 0;
+    qint64 m_bytesCaptured = 0;
+};
+
+// Reads a capture from a memory mapping; chunks point into the mapping
+class SMMCaptureReader
+{
+public:
+    struct Chunk
+    {
+        qint64 timeUs = 0; // Since the capture was opened
+        QByteArrayView data;
+    };
+
+    ~SMMCaptureReader() { close(); }
+
+    bool open(const QString &path, QString *error = nullptr);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+    qint64 startMs() const { return m_startMs; }
+
+    // Returns false at the end of the capture or at a truncated record
+    bool next(Chunk &chunk);
+    void rewind();
+
+private:
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    qint64 m_pos = 0;
+    qint64 m_timeUs = 0;
+    qint64 m_startMs = 0;
+};
+
+// Feeds a capture to a sink with its original timing scaled by a speed
+// factor (1 real time, N times faster), or as fast as possible with speed
+// 0. At full speed chunks go out in batches of MaxBatchBytes per event
+// loop pass, so queued consumers keep up and the replay can be stopped.
+class SMMCaptureReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Sink = std::function<void(QByteArrayView)>;
+
+    static constexpr qint64 MaxBatchBytes = 64 * 1024;
+
+    explicit SMMCaptureReplay(QObject *parent = nullptr);
+
+    void setSink(const Sink &sink) { m_sink = sink; }
+
+    bool start(const QString &path, double speed, QString *error = nullptr);
+    void stop();
+    bool isRunning() const { return m_reader.isOpen(); }
+
+    quint64 bytesReplayed() const { return m_bytesReplayed; }
+    quint64 chunksReplayed() const { return m_chunksReplayed; }
+    qint64 elapsedMs() const { return m_elapsedMs; }
+
+signals:
+    // The capture has been fed completely or the replay was stopped
+    void finished();
+
+private:
+    void feed();
+
+    SMMCaptureReader m_reader;
+    Sink m_sink;
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+    double m_speed = 1.0;
+    SMMCaptureReader::Chunk m_pending;
+    bool m_hasPending = false;
+    quint64 m_bytesReplayed = 0;
+    quint64 m_chunksReplayed = 0;
+    qint64 m_elapsedMs = 0;
+};
+
+#endif // SMMCAPTURE_H
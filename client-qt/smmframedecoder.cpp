@@ -0,0 +1,139 @@
+#include "smmframedecoder.h"
+
+#include <cstring>
+
+quint32 SMMByteRing::writableContiguous() const
+{
+    return qMin(freeSpace(), Capacity - (m_head & Mask));
+}
+
+quint32 SMMByteRing::append(const char *data, quint32 count)
+{
+    quint32 accepted = qMin(count, freeSpace());
+    quint32 first = qMin(accepted, Capacity - (m_head & Mask));
+
+    memcpy(m_data + (m_head & Mask), data, first);
+    memcpy(m_data, data + first, accepted - first);
+    m_head += accepted;
+    return accepted;
+}
+
+quint32 SMMByteRing::contiguousFrom(quint32 offset) const
+{
+    if (offset >= size())
+        return 0;
+    return qMin(size() - offset, Capacity - ((m_tail + offset) & Mask));
+}
+
+void SMMFrameDecoder::reset()
+{
+    m_ring.clear();
+    m_state = State::Sync;
+    m_frameSize = 0;
+}
+
+void SMMFrameDecoder::discard(quint32 count)
+{
+    m_ring.consume(count);
+    m_bytesDiscarded += count;
+}
+
+bool SMMFrameDecoder::findSync()
+{
+    const quint32 available = m_ring.size();
+
+    // The readable bytes are at most two contiguous spans; a pair split
+    // across the end of the ring is checked between them
+    quint32 offset = 0;
+    while (offset + 1 < available) {
+        const quint32 span = m_ring.contiguousFrom(offset);
+        const qsizetype found = SMM::findSync(m_ring.pointerAt(offset), span);
+        if (found >= 0) {
+            if (offset + found > 0)
+                discard(offset + quint32(found));
+            return true;
+        }
+
+        offset += span;
+        if (offset < available && m_ring.at(offset - 1) == SMM::SyncByte1
+                && m_ring.at(offset) == SMM::SyncByte2) {
+            discard(offset - 1);
+            return true;
+        }
+    }
+
+    // Keep a trailing 0xAA, it may be the first half of a split header
+    if (available > 0) {
+        bool keepLast = m_ring.at(available - 1) == SMM::SyncByte1;
+        discard(keepLast ? available - 1 : available);
+    }
+    return false;
+}
+
+uint8_t SMMFrameDecoder::ringChecksum(quint32 offset, quint32 count) const
+{
+    quint32 first = qMin(count, m_ring.contiguousFrom(offset));
+    uint8_t sum = SMM::checksum(m_ring.pointerAt(offset), int(first));
+    return SMM::checksum(m_ring.pointerAt(offset + first), int(count - first), sum);
+}
+
+bool SMMFrameDecoder::next(Frame &frame)
+{
+    for (;;) {
+        switch (m_state) {
+        case State::Sync:
+            if (!findSync())
+                return false;
+            m_state = State::Header;
+            Q_FALLTHROUGH();
+
+        case State::Header: {
+            if (m_ring.size() < SMM::HeaderSize)
+                return false;
+
+            uint8_t length = m_ring.at(2);
+            if (length == 0) {
+                // A frame must at least carry its code byte
+                discard(2);
+                m_state = State::Sync;
+                continue;
+            }
+            m_frameSize = 3 + length + 1;
+            m_state = State::Body;
+            Q_FALLTHROUGH();
+        }
+
+        case State::Body: {
+            if (m_ring.size() < m_frameSize)
+                return false;
+
+            uint8_t length = m_ring.at(2);
+            uint8_t received = m_ring.at(m_frameSize - 1);
+            m_state = State::Sync;
+
+            // Checksum covers LEN, CODE and DATA
+            if (ringChecksum(2, length + 1) != received) {
+                ++m_checksumErrors;
+                discard(2);
+                continue;
+            }
+
+            const quint32 payloadSize = length - 1;
+            const uint8_t *payload = m_ring.pointerAt(SMM::HeaderSize);
+            if (m_ring.contiguousFrom(SMM::HeaderSize) < payloadSize) {
+                // Frame wraps around the end of the ring: linearise it
+                quint32 first = m_ring.contiguousFrom(SMM::HeaderSize);
+                memcpy(m_scratch, payload, first);
+                memcpy(m_scratch + first, m_ring.pointerAt(SMM::HeaderSize + first), payloadSize - first);
+                payload = m_scratch;
+            }
+
+            frame.code = m_ring.at(3);
+            frame.payload = QByteArrayView(reinterpret_cast<const char *>(payload), qsizetype(payloadSize));
+            m_ring.consume(m_frameSize);
+            ++m_framesDecoded;
+            return true;
+        }
+        }
+    }
+}
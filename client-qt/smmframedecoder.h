@@ -0,0 +1,95 @@
+#ifndef SMMFRAMEDECODER_H
+#define SMMFRAMEDECODER_H
+
+#include <QByteArrayView>
+#include <QtGlobal>
+#include <cstdint>
+#include "smmkernels.h"
+
+// SMM frame layout: AA 55 | LEN | CODE | DATA (LEN - 1 bytes) | CHECKSUM
+// The checksum is the 8-bit sum of LEN, CODE and DATA.
+namespace SMM {
+constexpr uint8_t SyncByte1 = 0xAA;
+constexpr uint8_t SyncByte2 = 0x55;
+constexpr int HeaderSize = 4;          // sync (2) + length + code
+constexpr int MaxFrameSize = 3 + 255 + 1;
+
+// checksum() and findSync() are in smmkernels.h
+}
+
+// Fixed-capacity byte ring for serial input that has not been decoded yet.
+// Storage is allocated once; reads and writes only move the cursors.
+class SMMByteRing
+{
+public:
+    static constexpr quint32 Capacity = 4096; // Must be a power of two
+    static constexpr quint32 Mask = Capacity - 1;
+
+    quint32 size() const { return m_head - m_tail; }
+    quint32 freeSpace() const { return Capacity - size(); }
+    bool isEmpty() const { return m_head == m_tail; }
+
+    // Contiguous writable region at the write cursor (for QIODevice::read)
+    char *writePointer() { return reinterpret_cast<char *>(m_data + (m_head & Mask)); }
+    quint32 writableContiguous() const;
+    void commit(quint32 count) { m_head += count; }
+
+    // Copies as much of data as fits, returns the number of bytes accepted
+    quint32 append(const char *data, quint32 count);
+
+    uint8_t at(quint32 offset) const { return m_data[(m_tail + offset) & Mask]; }
+    void consume(quint32 count) { m_tail += qMin(count, size()); }
+    void clear() { m_head = m_tail = 0; }
+
+    // Readable bytes available without wrapping, starting at offset
+    quint32 contiguousFrom(quint32 offset) const;
+    const uint8_t *pointerAt(quint32 offset) const { return m_data + ((m_tail + offset) & Mask); }
+
+private:
+    alignas(64) uint8_t m_data[Capacity];
+    quint32 m_head = 0; // Write cursor (free running)
+    quint32 m_tail = 0; // Read cursor (free running)
+};
+
+// Resumable SMM frame decoder working in place on an SMMByteRing.
+// A partially received frame keeps its state between calls, so bytes are
+// never rescanned. Returned payload views point into the ring (or into an
+// internal scratch block when the frame wraps) and stay valid until the
+// next write to the ring.
+class SMMFrameDecoder
+{
+public:
+    struct Frame
+    {
+        uint8_t code = 0;
+        QByteArrayView payload;
+    };
+
+    SMMByteRing &ring() { return m_ring; }
+
+    // Returns true and fills frame when a complete, checksum-valid frame is available
+    bool next(Frame &frame);
+    void reset();
+
+    quint64 framesDecoded() const { return m_framesDecoded; }
+    quint64 checksumErrors() const { return m_checksumErrors; }
+    quint64 bytesDiscarded() const { return m_bytesDiscarded; }
+
+private:
+    enum class State { Sync, Header, Body };
+
+    bool findSync();
+    uint8_t ringChecksum(quint32 offset, quint32 count) const;
+    void discard(quint32 count);
+
+    SMMByteRing m_ring;
+    State m_state = State::Sync;
+    quint32 m_frameSize = 0;
+    uint8_t m_scratch[SMM::MaxFrameSize];
+
+    quint64 m_framesDecoded = 0;
+    quint64 m_checksumErrors = 0;
+    quint64 m_bytesDiscarded = 0;
+};
+
+#endif // SMMFRAMEDECODER_H
@@ -0,0 +1,212 @@
+#include "smmkernels.h"
+#include "smmframedecoder.h"
+
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SMM_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(SMM_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define SMM_HAVE_AVX2 1
+#define SMM_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using ChecksumFn = uint8_t (*)(const uint8_t *, int, uint8_t);
+using FindSyncFn = qsizetype (*)(const uint8_t *, qsizetype);
+
+uint8_t checksumScalar(const uint8_t *data, int size, uint8_t seed)
+{
+    uint8_t sum = seed;
+    for (int i = 0; i < size; ++i)
+        sum += data[i];
+    return sum;
+}
+
+qsizetype findSyncScalar(const uint8_t *data, qsizetype size)
+{
+    for (qsizetype i = 0; i + 1 < size; ++i) {
+        if (data[i] == SMM::SyncByte1 && data[i + 1] == SMM::SyncByte2)
+            return i;
+    }
+    return -1;
+}
+
+#ifdef SMM_HAVE_SSE2
+// PSADBW against zero adds 8 bytes at a time into 64-bit lanes, which
+// cannot overflow for any frame; the low byte of the total is the sum
+uint8_t checksumSse2(const uint8_t *data, int size, uint8_t seed)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(bytes, zero));
+    }
+    const uint8_t sum = uint8_t(seed + _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+    return checksumScalar(data + i, size - i, sum);
+}
+
+// Compares each position and the one after it, so a pair is found
+// wherever it falls relative to the 16-byte blocks
+qsizetype findSyncSse2(const uint8_t *data, qsizetype size)
+{
+    const __m128i first = _mm_set1_epi8(char(SMM::SyncByte1));
+    const __m128i second = _mm_set1_epi8(char(SMM::SyncByte2));
+    qsizetype i = 0;
+    for (; i + 17 <= size; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 1));
+        const int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, second)));
+        if (mask)
+            return i + qCountTrailingZeroBits(quint32(mask));
+    }
+    const qsizetype found = findSyncScalar(data + i, size - i);
+    return found < 0 ? -1 : i + found;
+}
+#endif
+
+#ifdef SMM_HAVE_AVX2
+SMM_TARGET_AVX2 uint8_t checksumAvx2(const uint8_t *data, int size, uint8_t seed)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    int i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(bytes, zero));
+    }
+    const __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    uint8_t sum = uint8_t(seed + _mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_srli_si128(half, 8)));
+
+    // The tail stays in this function: calling the non-VEX SSE2 code from
+    // here costs a state transition that outweighs the wider loop
+    for (; i < size; ++i)
+        sum += data[i];
+    return sum;
+}
+
+SMM_TARGET_AVX2 qsizetype findSyncAvx2(const uint8_t *data, qsizetype size)
+{
+    const __m256i first = _mm256_set1_epi8(char(SMM::SyncByte1));
+    const __m256i second = _mm256_set1_epi8(char(SMM::SyncByte2));
+    qsizetype i = 0;
+    for (; i + 33 <= size; i += 32) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 1));
+        const quint32 mask = quint32(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, second))));
+        if (mask)
+            return i + qCountTrailingZeroBits(mask);
+    }
+    for (; i + 1 < size; ++i) {
+        if (data[i] == SMM::SyncByte1 && data[i + 1] == SMM::SyncByte2)
+            return i;
+    }
+    return -1;
+}
+#endif
+
+bool supported(SMM::Kernels level)
+{
+    switch (level) {
+    case SMM::Kernels::Scalar:
+        return true;
+    case SMM::Kernels::Sse2:
+#ifdef SMM_HAVE_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case SMM::Kernels::Avx2:
+#ifdef SMM_HAVE_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+struct Dispatch
+{
+    SMM::Kernels level = SMM::Kernels::Scalar;
+    ChecksumFn checksum = checksumScalar;
+    FindSyncFn findSync = findSyncScalar;
+
+    Dispatch()
+    {
+        if (!select(SMM::Kernels::Avx2))
+            select(SMM::Kernels::Sse2);
+    }
+
+    bool select(SMM::Kernels wanted)
+    {
+        if (!supported(wanted))
+            return false;
+
+        level = wanted;
+        switch (wanted) {
+        case SMM::Kernels::Scalar:
+            checksum = checksumScalar;
+            findSync = findSyncScalar;
+            break;
+#ifdef SMM_HAVE_SSE2
+        case SMM::Kernels::Sse2:
+            checksum = checksumSse2;
+            findSync = findSyncSse2;
+            break;
+#endif
+#ifdef SMM_HAVE_AVX2
+        case SMM::Kernels::Avx2:
+            checksum = checksumAvx2;
+            findSync = findSyncAvx2;
+            break;
+#endif
+        default:
+            break;
+        }
+        return true;
+    }
+};
+
+Dispatch &dispatch()
+{
+    static Dispatch instance;
+    return instance;
+}
+}
+
+SMM::Kernels SMM::kernels()
+{
+    return dispatch().level;
+}
+
+const char *SMM::kernelsName(Kernels level)
+{
+    switch (level) {
+    case Kernels::Sse2: return "SSE2";
+    case Kernels::Avx2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+bool SMM::setKernels(Kernels level)
+{
+    return dispatch().select(level);
+}
+
+uint8_t SMM::checksum(const uint8_t *data, int size, uint8_t seed)
+{
+    return dispatch().checksum(data, size, seed);
+}
+
+qsizetype SMM::findSync(const uint8_t *data, qsizetype size)
+{
+    return dispatch().findSync(data, size);
+}
@@ -0,0 +1,30 @@
+#ifndef SMMKERNELS_H
+#define SMMKERNELS_H
+
+#include <QtGlobal>
+#include <cstdint>
+
+// Byte kernels of the SMM decoder: the sync pattern scan and the frame
+// checksum. Each has a scalar version and, on x86, SSE2 and AVX2 versions;
+// the widest one the CPU supports is picked on first use. AVX2 needs a
+// GCC or Clang build, other platforms use the scalar code.
+namespace SMM {
+
+enum class Kernels { Scalar, Sse2, Avx2 };
+
+Kernels kernels();
+const char *kernelsName(Kernels level);
+
+// Pins a level, for benchmarks; false if the CPU or build lacks it.
+// Not thread-safe, call before any decoding starts.
+bool setKernels(Kernels level);
+
+// 8-bit sum of data[0..size) added to seed
+uint8_t checksum(const uint8_t *data, int size, uint8_t seed = 0);
+
+// Index of the first AA 55 pair that lies completely in data[0..size),
+// or -1 if there is none
+qsizetype findSync(const uint8_t *data, qsizetype size);
+}
+
+#endif // SMMKERNELS_H
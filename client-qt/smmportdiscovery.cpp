@@ -0,0 +1,214 @@
+#include "smmportdiscovery.h"
+#include <QDebug>
+#include <QFuture>
+#include <QPromise>
+#include <QThreadPool>
+#include <sys/ioctl.h>
+#ifdef Q_OS_MAC
+#include <IOKit/serial/ioss.h>
+#endif
+
+// Port name of the adapter the monitors were first set up with; still
+// accepted when the USB IDs of a port cannot be read
+static const char LegacyPortName[] = "PL2303G-USBtoUART";
+
+SMMPortDiscovery::SMMPortDiscovery(QObject *parent)
+    : QObject(parent)
+{
+    m_requestTimer = new QTimer(this);
+    m_requestTimer->setSingleShot(true);
+    m_requestTimer->setInterval(ProbeRequestDelayMs);
+    connect(m_requestTimer, &QTimer::timeout, this, &SMMPortDiscovery::sendRequests);
+
+    m_timeoutTimer = new QTimer(this);
+    m_timeoutTimer->setSingleShot(true);
+    m_timeoutTimer->setInterval(ProbeTimeoutMs);
+    connect(m_timeoutTimer, &QTimer::timeout, this, [this]() {
+        // No answer: fall back to the only port that opened, if any
+        finish(m_probes.size() == 1 ? m_probes.front()->location : QString());
+    });
+}
+
+SMMPortDiscovery::~SMMPortDiscovery()
+{
+    cancel();
+}
+
+const QList<SMMPortDiscovery::UsbId> &SMMPortDiscovery::knownAdapters()
+{
+    static const QList<UsbId> adapters = {
+        {0x067B, 0x2303}, // PL2303 (HX/TA)
+        {0x067B, 0x23A3}, // PL2303GC
+        {0x067B, 0x23B3}, // PL2303GB
+        {0x067B, 0x23C3}, // PL2303GT
+        {0x067B, 0x23D3}, // PL2303GL
+        {0x067B, 0x23E3}, // PL2303GE
+        {0x067B, 0x23F3}  // PL2303GS
+    };
+    return adapters;
+}
+
+bool SMMPortDiscovery::isKnownAdapter(const QSerialPortInfo &info)
+{
+    if (!info.hasVendorIdentifier() || !info.hasProductIdentifier())
+        return info.portName().contains(QLatin1String(LegacyPortName));
+
+    for (const UsbId &id : knownAdapters()) {
+        if (info.vendorIdentifier() == id.vendorId && info.productIdentifier() == id.productId)
+            return true;
+    }
+    return false;
+}
+
+bool SMMPortDiscovery::openPort(QSerialPort *port, const QString &portName)
+{
+    port->setPortName(portName);
+    port->setBaudRate(QSerialPort::Baud115200);
+    port->setParity(QSerialPort::OddParity);
+    port->setDataBits(QSerialPort::Data8);
+    port->setStopBits(QSerialPort::OneStop);
+    port->setFlowControl(QSerialPort::NoFlowControl);
+
+    if (!port->open(QIODevice::ReadWrite)) {
+        qWarning() << "Port could not be opened:" << portName << port->errorString();
+        return false;
+    }
+
+#ifdef Q_OS_MAC
+    int fd = port->handle();
+    int customBaud = 375000;
+    if (fd != -1 && ioctl(fd, IOSSIOSPEED, &customBaud) == 0) {
+        qDebug() << "Baud rate set to 375000.";
+    } else {
+        qWarning() << "Custom baud rate could not be set.";
+    }
+#endif
+
+    port->clear();
+    return true;
+}
+
+void SMMPortDiscovery::setProbeRequests(const QByteArray &handshake, const QList<QByteArray> &requests)
+{
+    m_handshake = handshake;
+    m_requests = requests;
+}
+
+void SMMPortDiscovery::start()
+{
+    cancel();
+    m_enumerating = true;
+
+    // availablePorts() walks the system's device registry; keep it off this
+    // thread. The continuation runs back on it, and not at all once this
+    // object is gone.
+    auto promise = std::make_shared<QPromise<QStringList>>();
+    QFuture<QStringList> future = promise->future();
+    promise->start();
+    QThreadPool::globalInstance()->start([promise]() {
+        QStringList candidates;
+        const QList<QSerialPortInfo> ports = QSerialPortInfo::availablePorts();
+        for (const QSerialPortInfo &info : ports) {
+            if (isKnownAdapter(info))
+                candidates.append(info.systemLocation());
+        }
+        promise->addResult(candidates);
+        promise->finish();
+    });
+
+    const quint64 generation = m_generation;
+    future.then(this, [this, generation](const QStringList &candidates) {
+        if (m_generation != generation)
+            return;
+        m_enumerating = false;
+        probe(candidates);
+    });
+}
+
+void SMMPortDiscovery::cancel()
+{
+    ++m_generation;
+    m_enumerating = false;
+    m_requestTimer->stop();
+    m_timeoutTimer->stop();
+
+    for (const std::unique_ptr<Probe> &probe : m_probes) {
+        probe->port->disconnect(this);
+        probe->port->close();
+        probe->port->deleteLater();
+    }
+    m_probes.clear();
+}
+
+void SMMPortDiscovery::probe(const QStringList &portNames)
+{
+    for (const QString &portName : portNames) {
+        auto probe = std::make_unique<Probe>();
+        probe->port = new QSerialPort(this);
+        probe->location = portName;
+        if (!openPort(probe->port, portName)) {
+            delete probe->port;
+            continue;
+        }
+
+        Probe *raw = probe.get();
+        connect(raw->port, &QSerialPort::readyRead, this, [this, raw]() { readProbe(raw); });
+        raw->port->write(m_handshake);
+        m_probes.push_back(std::move(probe));
+    }
+
+    if (m_probes.empty()) {
+        qDebug() << "No SMM monitor found among" << portNames.size() << "candidate ports";
+        emit notFound();
+        return;
+    }
+
+    qDebug() << "Probing" << m_probes.size() << "candidate ports for an SMM monitor";
+    m_requestTimer->start();
+    m_timeoutTimer->start();
+}
+
+void SMMPortDiscovery::sendRequests()
+{
+    for (const std::unique_ptr<Probe> &probe : m_probes) {
+        for (const QByteArray &request : std::as_const(m_requests))
+            probe->port->write(request);
+    }
+}
+
+void SMMPortDiscovery::readProbe(Probe *probe)
+{
+    SMMByteRing &ring = probe->decoder.ring();
+    while (probe->port->bytesAvailable() > 0) {
+        quint32 space = ring.writableContiguous();
+        if (space == 0) {
+            // Only the first frame matters; drop what was not one
+            ring.clear();
+            space = ring.writableContiguous();
+        }
+
+        const qint64 bytesRead = probe->port->read(ring.writePointer(), space);
+        if (bytesRead <= 0)
+            break;
+        ring.commit(quint32(bytesRead));
+
+        SMMFrameDecoder::Frame frame;
+        if (probe->decoder.next(frame)) {
+            finish(probe->location);
+            return;
+        }
+    }
+}
+
+void SMMPortDiscovery::finish(QString location)
+{
+    // By value: the probe holding location is destroyed by cancel()
+    cancel();
+
+    if (location.isEmpty()) {
+        emit notFound();
+    } else {
+        qDebug() << "SMM monitor found on" << location;
+        emit found(location);
+    }
+}
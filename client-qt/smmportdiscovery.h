@@ -0,0 +1,84 @@
+#ifndef SMMPORTDISCOVERY_H
+#define SMMPORTDISCOVERY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QSerialPort>
+#include <QSerialPortInfo>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+#include <vector>
+#include "smmframedecoder.h"
+
+// Finds the serial port an SMM monitor is attached to, without blocking.
+//
+// Ports are enumerated on the global thread pool and filtered by the USB
+// vendor/product IDs of the supported USB-serial adapters. Every candidate
+// is then opened and probed at the same time on the caller's thread: it
+// gets the handshake, then the data requests, and the first port to answer
+// with a checksum-valid SMM frame within ProbeTimeoutMs wins. If none
+// answers but exactly one candidate could be opened, that one is reported,
+// since a monitor may stay silent until it is fully configured.
+class SMMPortDiscovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct UsbId
+    {
+        quint16 vendorId;
+        quint16 productId;
+    };
+
+    static constexpr int ProbeTimeoutMs = 3000;
+    static constexpr int ProbeRequestDelayMs = 500; // Handshake to first request
+
+    explicit SMMPortDiscovery(QObject *parent = nullptr);
+    ~SMMPortDiscovery();
+
+    // Bytes written to every candidate: handshake first, requests after
+    void setProbeRequests(const QByteArray &handshake, const QList<QByteArray> &requests);
+
+    // Reports found() or notFound() once per start(); a new start() or
+    // cancel() drops a discovery still running
+    void start();
+    void cancel();
+    bool isRunning() const { return !m_probes.empty() || m_enumerating; }
+
+    // USB-serial adapters the monitors ship with (Prolific PL2303 family)
+    static const QList<UsbId> &knownAdapters();
+    static bool isKnownAdapter(const QSerialPortInfo &info);
+
+    // Applies the SMM line settings (and the custom baud rate on macOS) and opens the port
+    static bool openPort(QSerialPort *port, const QString &portName);
+
+signals:
+
+    void found(const QString &portName);
+    void notFound();
+
+private:
+    struct Probe
+    {
+        QSerialPort *port;
+        QString location;
+        SMMFrameDecoder decoder;
+    };
+
+    void probe(const QStringList &portNames);
+    void readProbe(Probe *probe);
+    void sendRequests();
+    void finish(QString location);
+
+    QByteArray m_handshake;
+    QList<QByteArray> m_requests;
+    std::vector<std::unique_ptr<Probe>> m_probes;
+    QTimer *m_requestTimer;
+    QTimer *m_timeoutTimer;
+    quint64 m_generation = 0;
+    bool m_enumerating = false;
+};
+
+#endif // SMMPORTDISCOVERY_H
@@ -3,34 +3,58 @@
 #include "devicemanager.h"
 
 #include <QDebug>
-#include <QThread>
+#include <QDateTime>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <termios.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
-#ifdef Q_OS_MAC
-#include <IOKit/serial/ioss.h>
-#endif
+#include <cstring>
 
-SMMProtocolTest::SMMProtocolTest(QObject *parent) : QObject(parent)
+// Frames each configuration command turns on (in packetCommands order) and
+// how long a channel may stay silent before the watchdog re-sends it
+struct ChannelSpec
+{
+    const char *name;
+    uint8_t dataCode;
+    int silenceMs;
+};
+
+static constexpr ChannelSpec ChannelSpecs[SMMProtocolTest::DataChannelCount] = {
+    {"ECG", 0x01, 1000},
+    {"pleth", 0x15, 1000},
+    {"resp waveform", 0x03, 1000},
+    {"resp rate", 0x04, 3000}
+};
+
+SMMProtocolTest::SMMProtocolTest(QObject *parent) : VitalSource(parent)
 {
     serial = new QSerialPort(this);
-    connectionTimer = new QTimer(this);
-    dataRequestTimer = new QTimer(this);
-    sequentialTimer = new QTimer(this);
+    commandTimer = new QTimer(this);
+    watchdogTimer = new QTimer(this);
 
     connect(serial, &QSerialPort::readyRead, this, &SMMProtocolTest::readData);
     connect(serial, &QSerialPort::errorOccurred, this, &SMMProtocolTest::handleError);
-    connect(connectionTimer, &QTimer::timeout, this, &SMMProtocolTest::sendConnectionSequence);
-    connect(dataRequestTimer, &QTimer::timeout, this, &SMMProtocolTest::startSequentialRequests);
-    connect(sequentialTimer, &QTimer::timeout, this, &SMMProtocolTest::sendNextPacket);
+    connect(commandTimer, &QTimer::timeout, this, &SMMProtocolTest::commandTimedOut);
+    connect(watchdogTimer, &QTimer::timeout, this, &SMMProtocolTest::checkChannels);
 
-    dataRequestTimer->setSingleShot(false);
-    sequentialTimer->setSingleShot(true);
+    commandTimer->setSingleShot(true);
+    watchdogTimer->setInterval(WatchdogIntervalMs);
 
-    currentPacketIndex = 0;
     packetCommands = createIndividualCommands();
+
+    discovery = new SMMPortDiscovery(this);
+    discovery->setProbeRequests(QByteArray::fromHex("BF5FFF"), packetCommands);
+    connect(discovery, &SMMPortDiscovery::found, this, [this](const QString &portName) {
+        if (m_isMonitoring && !connectToDevice(portName))
+            scheduleReconnect();
+    });
+    connect(discovery, &SMMPortDiscovery::notFound, this, &SMMProtocolTest::scheduleReconnect);
+
+    reconnectTimer = new QTimer(this);
+    reconnectTimer->setSingleShot(true);
+    connect(reconnectTimer, &QTimer::timeout, this, &SMMProtocolTest::start);
+
+    replay = new SMMCaptureReplay(this);
+    replay->setSink([this](QByteArrayView bytes) { feedBytes(bytes); });
+    connect(replay, &SMMCaptureReplay::finished, this, &SMMProtocolTest::finishReplay);
 }
 
 SMMProtocolTest::~SMMProtocolTest()
@@ -42,25 +66,42 @@ SMMProtocolTest::~SMMProtocolTest()
 
 void SMMProtocolTest::start()
 {
-    databaseClass::instance()->setupDatabase();
-
-    QStringList portNamesToTry = {
-        "/dev/cu.PL2303G-USBtoUART110",
-        "cu.PL2303G-USBtoUART110"
-    };
+    if (m_portName.isEmpty()) {
+        // Answers asynchronously through found() / notFound()
+        discovery->start();
+        return;
+    }
 
-    bool connected = false;
-    for (const QString &portName : portNamesToTry) {
-        if (connectToDevice(portName)) {
-            qDebug() << "Connection successful:" << portName;
-            connected = true;
-            break;
-        }
+    if (connectToDevice(m_portName)) {
+        qDebug() << "Connection successful:" << m_portName;
+    } else {
+        qWarning() << "Could not connect to" << m_portName;
+        scheduleReconnect();
     }
+}
 
-    if (!connected) {
-        qWarning() << "Could not connect to any port.";
+void SMMProtocolTest::scheduleReconnect()
+{
+    if (!m_isMonitoring || reconnectTimer->isActive())
+        return;
+
+    qDebug() << "Retrying the SMM connection in" << m_reconnectDelayMs << "ms";
+    reconnectTimer->start(m_reconnectDelayMs);
+    m_reconnectDelayMs = qMin(m_reconnectDelayMs * 2, MaxReconnectDelayMs);
+}
+
+void SMMProtocolTest::closePort()
+{
+    commandTimer->stop();
+    watchdogTimer->stop();
+    m_pendingCommands.clear();
+    m_linkState = LinkState::Closed;
+
+    if (serial && serial->isOpen()) {
+        serial->close();
     }
+
+    decoder.reset();
 }
 
 void SMMProtocolTest::startMonitoring()
@@ -69,6 +110,10 @@ void SMMProtocolTest::startMonitoring()
         return; // Monitoring is already active
     }
 
+    // The port and a replay would feed the same parser
+    if (replay->isRunning())
+        stopReplay();
+
     m_isMonitoring = true;
     emit monitoringChanged();
 
@@ -81,97 +126,182 @@ void SMMProtocolTest::stopMonitoring()
 {
     m_isMonitoring = false;
 
-    // Stop all timers
-    connectionTimer->stop();
-    dataRequestTimer->stop();
-    sequentialTimer->stop();
-
-    // Close serial port
-    if (serial && serial->isOpen()) {
-        serial->close();
-    }
-
-    connectionSent = false;
+    // Stop discovery, reconnection, all timers and close the serial port
+    discovery->cancel();
+    reconnectTimer->stop();
+    m_reconnectDelayMs = InitialReconnectDelayMs;
+    closePort();
+    m_waveformStore.close();
     qDebug() << "Monitoring stopped";
     emit monitoringChanged();
 }
 
 bool SMMProtocolTest::connectToDevice(const QString &portName)
 {
-    if (serial->isOpen()) {
-        serial->close();
-        QThread::msleep(100);
-    }
+    // Reopening needs no settle time; nothing here may block the event loop
+    closePort();
 
-    serial->setPortName(portName);
-    serial->setBaudRate(QSerialPort::Baud115200);
-    serial->setParity(QSerialPort::OddParity);
-    serial->setDataBits(QSerialPort::Data8);
-    serial->setStopBits(QSerialPort::OneStop);
-    serial->setFlowControl(QSerialPort::NoFlowControl);
-
-    if (!serial->open(QIODevice::ReadWrite)) {
-        qWarning() << "Port could not be opened:" << serial->errorString();
+    if (!SMMPortDiscovery::openPort(serial, portName))
         return false;
-    }
-
-#ifdef Q_OS_MAC
-    int fd = serial->handle();
-    int customBaud = 375000;
-    if (fd != -1 && ioctl(fd, IOSSIOSPEED, &customBaud) == 0) {
-        qDebug() << "Baud rate set to 375000.";
-    } else {
-        qWarning() << "Custom baud rate could not be set.";
-    }
-#endif
 
-    serial->clear();
-    connectionTimer->start(1000);
+    decoder.reset();
     m_isMonitoring = true;
     emit monitoringChanged();
+
+    m_linkClock.start();
+    m_timeToFirstWaveformMs.store(-1, std::memory_order_relaxed);
+    for (ChannelLiveness &channel : m_channels)
+        channel.lastSeenClockMs = channel.lastArmClockMs = 0;
+    sendHandshake();
     return true;
 }
 
-void SMMProtocolTest::sendConnectionSequence()
+void SMMProtocolTest::sendHandshake()
 {
-    if (connectionSent || !serial->isOpen()) return;
+    // Written from the event loop as the port drains
+    serial->write(QByteArray::fromHex("BF5FFF"));
+    m_linkState = LinkState::Handshake;
+    commandTimer->start(HandshakeTimeoutMs);
+}
 
-    QByteArray handshake = QByteArray::fromHex("BF5FFF");
-    serial->write(handshake);
-    serial->flush();
-    serial->waitForBytesWritten(1000);
+void SMMProtocolTest::beginConfiguration()
+{
+    m_linkState = LinkState::Configuring;
+    m_nextCommand = 0;
+    m_pendingCommands.clear();
+    fillCommandPipeline();
+}
 
-    connectionSent = true;
-    connectionTimer->stop();
+void SMMProtocolTest::fillCommandPipeline()
+{
+    while (m_pendingCommands.size() < PipelineDepth && m_nextCommand < packetCommands.size()) {
+        serial->write(packetCommands.at(m_nextCommand));
+        m_pendingCommands.append({m_nextCommand, m_linkClock.elapsed()});
+        ++m_nextCommand;
+    }
 
-    QTimer::singleShot(2000, [this]() {
-        if (m_isMonitoring) {
-            dataRequestTimer->start(5000);
-        }
-    });
+    if (m_pendingCommands.isEmpty()) {
+        // Every channel gets its full silence limit from here on
+        const qint64 now = m_linkClock.elapsed();
+        for (ChannelLiveness &channel : m_channels)
+            channel.lastArmClockMs = now;
+
+        m_linkState = LinkState::Streaming;
+        commandTimer->stop();
+        watchdogTimer->start();
+        return;
+    }
+    armCommandTimer();
 }
 
-void SMMProtocolTest::startSequentialRequests()
+void SMMProtocolTest::armCommandTimer()
 {
-    if (!serial->isOpen() || !m_isMonitoring) return;
+    // Fires when the oldest outstanding command runs out of time
+    const qint64 due = m_pendingCommands.first().sentMs + CommandTimeoutMs;
+    commandTimer->start(int(qMax<qint64>(0, due - m_linkClock.elapsed())));
+}
 
-    currentPacketIndex = 0;
-    sendNextPacket();
+void SMMProtocolTest::commandTimedOut()
+{
+    switch (m_linkState) {
+    case LinkState::Handshake:
+        // Devices that do not answer the handshake still take commands
+        beginConfiguration();
+        break;
+    case LinkState::Configuring:
+        qDebug() << "SMM" << ChannelSpecs[m_pendingCommands.first().channel].name << "command not answered, moving on";
+        m_pendingCommands.removeFirst();
+        fillCommandPipeline();
+        break;
+    default:
+        break;
+    }
+}
+
+void SMMProtocolTest::checkChannels()
+{
+    if (!serial->isOpen() || !m_isMonitoring || m_linkState != LinkState::Streaming)
+        return;
+
+    const qint64 now = m_linkClock.elapsed();
+    for (int i = 0; i < DataChannelCount; ++i) {
+        ChannelLiveness &channel = m_channels[i];
+        const qint64 silence = now - qMax(channel.lastSeenClockMs, channel.lastArmClockMs);
+        if (silence < ChannelSpecs[i].silenceMs)
+            continue;
+
+        qDebug() << "No SMM" << ChannelSpecs[i].name << "data for" << silence << "ms, re-arming";
+        serial->write(packetCommands.at(i));
+        channel.lastArmClockMs = now;
+        channel.rearmCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static int channelForCode(uint8_t code)
+{
+    for (int i = 0; i < SMMProtocolTest::DataChannelCount; ++i) {
+        if (ChannelSpecs[i].dataCode == code)
+            return i;
+    }
+    return -1;
+}
+
+void SMMProtocolTest::onFrameReceived(uint8_t code)
+{
+    const int channel = channelForCode(code);
+    if (channel >= 0) {
+        m_channels[channel].lastSeenClockMs = m_linkClock.elapsed();
+        m_channels[channel].lastSeenMs.store(QDateTime::currentMSecsSinceEpoch(), std::memory_order_relaxed);
+    }
+
+    if (m_timeToFirstWaveformMs.load(std::memory_order_relaxed) < 0
+            && (code == 0x01 || code == 0x03 || code == 0x15)) {
+        const qint64 elapsed = m_linkClock.elapsed();
+        m_timeToFirstWaveformMs.store(elapsed, std::memory_order_relaxed);
+        qDebug() << "Time to first waveform:" << elapsed << "ms";
+    }
+
+    switch (m_linkState) {
+    case LinkState::Handshake:
+        beginConfiguration();
+        break;
+    case LinkState::Configuring:
+        for (int i = 0; i < m_pendingCommands.size(); ++i) {
+            if (m_pendingCommands.at(i).channel == channel) {
+                m_pendingCommands.removeAt(i);
+                fillCommandPipeline();
+                break;
+            }
+        }
+        break;
+    default:
+        break;
+    }
 }
 
-void SMMProtocolTest::sendNextPacket()
+qint64 SMMProtocolTest::channelLastSeenMs(int channel) const
 {
-    if (!serial->isOpen() || !m_isMonitoring || currentPacketIndex >= packetCommands.size()) return;
+    return channel >= 0 && channel < DataChannelCount
+        ? m_channels[channel].lastSeenMs.load(std::memory_order_relaxed) : 0;
+}
 
-    QByteArray packet = packetCommands[currentPacketIndex];
-    serial->write(packet);
-    serial->flush();
-    serial->waitForBytesWritten(100);
+quint32 SMMProtocolTest::channelRearmCount(int channel) const
+{
+    return channel >= 0 && channel < DataChannelCount
+        ? m_channels[channel].rearmCount.load(std::memory_order_relaxed) : 0;
+}
 
-    currentPacketIndex++;
-    if (currentPacketIndex < packetCommands.size() && m_isMonitoring) {
-        sequentialTimer->start(1000);
+QVariantList SMMProtocolTest::channelStatus() const
+{
+    QVariantList status;
+    for (int i = 0; i < DataChannelCount; ++i) {
+        QVariantMap channel;
+        channel["name"] = QString::fromLatin1(ChannelSpecs[i].name);
+        channel["lastSeenMs"] = channelLastSeenMs(i);
+        channel["rearmCount"] = channelRearmCount(i);
+        status.append(channel);
     }
+    return status;
 }
 
 QList<QByteArray> SMMProtocolTest::createIndividualCommands()
@@ -187,17 +317,16 @@ QList<QByteArray> SMMProtocolTest::createIndividualCommands()
 QByteArray SMMProtocolTest::createSMMPacket(uint8_t code, const QByteArray &data)
 {
     QByteArray packet;
-    packet.append(0xAA);
-    packet.append(0x55);
+    packet.reserve(SMM::HeaderSize + data.size() + 1);
+    packet.append(char(SMM::SyncByte1));
+    packet.append(char(SMM::SyncByte2));
     uint8_t length = data.size() + 1;
     packet.append(length);
     packet.append(code);
     packet.append(data);
 
-    uint8_t checksum = length + code;
-    for (char byte : data) {
-        checksum += static_cast<uint8_t>(byte);
-    }
+    uint8_t checksum = SMM::checksum(reinterpret_cast<const uint8_t *>(data.constData()),
+                                     data.size(), length + code);
     packet.append(checksum);
     return packet;
 }
@@ -206,98 +335,65 @@ void SMMProtocolTest::readData()
 {
     if (!m_isMonitoring) return;
 
-    QByteArray incoming = serial->readAll();
-    if (incoming.isEmpty()) return;
+    // Read straight into the decoder ring; whatever does not fit stays in
+    // the QSerialPort buffer until the frames ahead of it are parsed
+    SMMByteRing &ring = decoder.ring();
+    while (serial->bytesAvailable() > 0) {
+        quint32 space = ring.writableContiguous();
+        if (space == 0) {
+            parseBufferedData();
+            space = ring.writableContiguous();
+            if (space == 0)
+                break;
+        }
 
-    qDebug() << "Incoming data:" << incoming.toHex(' ').toUpper();
+        qint64 bytesRead = serial->read(ring.writePointer(), space);
+        if (bytesRead <= 0)
+            break;
+        m_capture.write(ring.writePointer(), bytesRead);
+        ring.commit(quint32(bytesRead));
+    }
 
-    buffer.append(incoming);
     parseBufferedData();
 }
 
-void SMMProtocolTest::parseBufferedData()
+void SMMProtocolTest::feedBytes(QByteArrayView bytes)
 {
-    while (buffer.size() >= 4) {
-        int headerIndex = buffer.indexOf(QByteArray::fromHex("AA55"));
-        if (headerIndex == -1) {
-            buffer.clear();
-            return;
-        }
-
-        if (headerIndex > 0)
-            buffer.remove(0, headerIndex);
-
-        if (buffer.size() < 4)
-            return;
-
-        uint8_t length = static_cast<uint8_t>(buffer[2]);
-        int totalSize = 3 + length + 1;
-
-        if (buffer.size() < totalSize)
-            return;
-
-        QByteArray packet = buffer.left(totalSize);
-        uint8_t code = static_cast<uint8_t>(packet[3]);
-        QByteArray payload = packet.mid(4, length - 1);
-
-        uint8_t receivedChecksum = static_cast<uint8_t>(packet[totalSize - 1]);
-        uint8_t calculatedChecksum = length + code;
-        for (char byte : payload) {
-            calculatedChecksum += static_cast<uint8_t>(byte);
-        }
-
-        if (receivedChecksum == calculatedChecksum) {
-            parsePacketByCode(code, payload);
-        }
-
-        buffer.remove(0, totalSize);
+    // The ring always has room for more than the partial frame left behind
+    SMMByteRing &ring = decoder.ring();
+    while (!bytes.isEmpty()) {
+        const quint32 accepted = ring.append(bytes.data(), quint32(bytes.size()));
+        bytes = bytes.sliced(accepted);
+        parseBufferedData();
     }
 }
 
-void SMMProtocolTest::parsePacketByCode(uint8_t code, const QByteArray &payload)
+void SMMProtocolTest::parseBufferedData()
 {
-    QString hexDump;
-    for (uint8_t byte : payload) {
-        hexDump += QString("%1 ").arg(byte, 2, 16, QLatin1Char('0')).toUpper();
+    SMMFrameDecoder::Frame frame;
+    while (decoder.next(frame)) {
+        m_reconnectDelayMs = InitialReconnectDelayMs;
+        onFrameReceived(frame.code);
+        parsePacketByCode(frame.code, frame.payload);
     }
+}
 
+void SMMProtocolTest::parsePacketByCode(uint8_t code, QByteArrayView payload)
+{
     switch (code) {
     case 0x01:
     {
         if (payload.size() >= 57) // 56 byte ECG + 1 FLAG2
         {
-            const QStringList leadNames = {
-                "Lead I", "Lead II", "Lead III", "Lead V",
-                "Lead aVR", "Lead aVF", "Lead aVL"
-            };
-
-            const int samplesPerLead = 8;
-
-            for (int lead = 0; lead < 7; ++lead)
-            {
-                int startIndex = lead * samplesPerLead;
-                QVector<uint8_t> samples;
-
-                for (int i = 0; i < samplesPerLead; ++i) {
-                    samples.append(static_cast<uint8_t>(payload[startIndex + i]));
-                }
-
-                // Send sample to UI only for Lead I
-                if (lead == 0 && !samples.isEmpty()) {
-                    m_ecgSample = samples.last();
-                    emit ecgWaveformSampleReceived();
-                    qDebug() << QString("📈 [ECG] %1 → %2")
-                                    .arg(leadNames[lead])
-                                    .arg(samples.last());
+            if (m_waveformStore.isRecording()) {
+                const auto *samples = reinterpret_cast<const quint8 *>(payload.data());
+                for (int lead = 0; lead < EcgBlock::LeadCount; ++lead) {
+                    m_waveformStore.append(WaveformStore::Channel(WaveformStore::EcgI + lead),
+                                           samples + lead * EcgBlock::SamplesPerLead,
+                                           EcgBlock::SamplesPerLead);
                 }
-
-                // Display all leads in terminal (optional)
-                qDebug() << QString("[0x01] %1 Samples:").arg(leadNames[lead]) << samples;
             }
-
-            // FLAG2 analysis
-            uint8_t flag2 = static_cast<uint8_t>(payload[56]);
-            qDebug() << "[0x01] FLAG2:" << QString("0x%1").arg(flag2, 2, 16, QChar('0')).toUpper();
+            publishEcgBlock(payload);
         }
         else
         {
@@ -308,8 +404,8 @@ void SMMProtocolTest::parsePacketByCode(uint8_t code, const QByteArray &payload)
 
     case 0x03: {
         if (payload.size() >= 1) {
-            m_respSample = static_cast<uint8_t>(payload[0]);
-            emit respWaveformSampleReceived();
+            m_waveformStore.append(WaveformStore::Resp, static_cast<uint8_t>(payload[0]));
+            publish(SMMEvent::RespSample, static_cast<uint8_t>(payload[0]));
         }
         break;
     }
@@ -320,18 +416,10 @@ void SMMProtocolTest::parsePacketByCode(uint8_t code, const QByteArray &payload)
 
             if (rr == 0 || rr == 0xFF || rr < 5 || rr > 80) {
                 qDebug() << "[0x04] RESP value invalid or sensor not connected:" << rr;
-                m_respirationRate = "Geçersiz";
-                m_cachedResp = "Geçersiz";
-                emit respirationRateChanged();
+                publish(SMMEvent::RespirationRate, SMMEvent::Invalid);
             } else {
-                QString rrStr = QString::number(rr);
-                m_respirationRate = rrStr;
-                m_cachedResp = rrStr;
-                emit respirationRateChanged();
-                qDebug() << "Emitted respirationRateChanged:" << rrStr;
+                publish(SMMEvent::RespirationRate, rr);
             }
-
-            tryInsertMeasurement();
         }
         break;
     }
@@ -342,36 +430,201 @@ void SMMProtocolTest::parsePacketByCode(uint8_t code, const QByteArray &payload)
             uint8_t spo2 = static_cast<uint8_t>(payload[3]);
             uint16_t pulse = (static_cast<uint8_t>(payload[4]) << 8) | static_cast<uint8_t>(payload[5]);
 
-            QString spo2Str = (spo2 == 0x7F || spo2 > 100) ? "Geçersiz" : QString::number(spo2);
-            QString pulseStr = (pulse > 240 || pulse == 0 || pulse == 0xFFFF) ? "Geçersiz" : QString::number(pulse);
+            bool spo2Valid = !(spo2 == 0x7F || spo2 > 100);
+            bool pulseValid = !(pulse > 240 || pulse == 0 || pulse == 0xFFFF);
 
-            if (spo2Str != m_spo2) {
-                m_spo2 = spo2Str;
-                m_cachedSpO2 = spo2Str;
-                emit spo2Changed();
-            }
+            publish(SMMEvent::Spo2, spo2Valid ? spo2 : SMMEvent::Invalid);
+            publish(SMMEvent::HeartRate, pulseValid ? pulse : SMMEvent::Invalid);
+            m_waveformStore.append(WaveformStore::Pleth, waveformRaw);
+            publish(SMMEvent::PlethSample, waveformRaw);
+        }
+        break;
+    }
 
-            if (pulseStr != m_heartRate) {
-                m_heartRate = pulseStr;
-                m_cachedHeartRate = pulseStr;
-                emit heartRateChanged();
-            }
+    default:
+        break;
+    }
+}
+
+void SMMProtocolTest::publish(SMMEvent::Kind kind, int value)
+{
+    const SMMEvent event{kind, value};
+
+    if (!m_waveformDelivery.load(std::memory_order_relaxed)
+            && (kind == SMMEvent::PlethSample || kind == SMMEvent::RespSample))
+        return;
+
+    if (!m_queuedDelivery.load(std::memory_order_relaxed)) {
+        applyEvent(event);
+        return;
+    }
+
+    if (!m_eventQueue.tryPush(event)) {
+        m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // One pending notification is enough, the consumer drains everything
+    if (!m_drainPending.exchange(true, std::memory_order_acq_rel))
+        emit eventsPending();
+}
+
+void SMMProtocolTest::publishEcgBlock(QByteArrayView payload)
+{
+    if (!m_waveformDelivery.load(std::memory_order_relaxed))
+        return;
+
+    EcgBlock block;
+    memcpy(block.samples, payload.data(), sizeof(block.samples));
+    block.flag2 = static_cast<uint8_t>(payload[56]);
+
+    if (!m_queuedDelivery.load(std::memory_order_relaxed)) {
+        m_ecgBlock = block;
+        applyEvent(SMMEvent{SMMEvent::EcgPacket, 0});
+        return;
+    }
+
+    // Only this thread pushes, so a free event slot now is still free below
+    if (m_eventQueue.size() == m_eventQueue.capacity() || !m_ecgBlockQueue.tryPush(block)) {
+        m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    publish(SMMEvent::EcgPacket, 0);
+}
+
+void SMMProtocolTest::setRecordingPatient(const QString &patientId)
+{
+    // Replayed samples are not the patient's; recording resumes afterwards
+    if (replay->isRunning()) {
+        m_replayPatientId = patientId;
+        return;
+    }
+    m_waveformStore.setPatient(patientId);
+}
+
+void SMMProtocolTest::setCaptureFile(const QString &path)
+{
+    if (path.isEmpty())
+        m_capture.close();
+    else
+        m_capture.open(path);
+}
+
+bool SMMProtocolTest::startReplay(const QString &path, double speed)
+{
+    if (replay->isRunning())
+        stopReplay();
+    if (m_isMonitoring)
+        stopMonitoring();
+
+    m_replayPatientId = m_waveformStore.patientId();
+    m_waveformStore.setPatient(QString());
+    decoder.reset();
+    m_replayFirstFrame = decoder.framesDecoded();
+    m_replayFirstChecksumError = decoder.checksumErrors();
+
+    QString error;
+    if (!replay->start(path, speed, &error)) {
+        qWarning() << "Cannot replay" << path << ":" << error;
+        m_waveformStore.setPatient(m_replayPatientId);
+        emit replayFinished(0, 0, 0);
+        return false;
+    }
+    qDebug() << "Replaying" << path << "at" << (speed > 0 ? QString("%1x").arg(speed) : QString("full speed"));
+    return true;
+}
+
+void SMMProtocolTest::stopReplay()
+{
+    replay->stop();
+}
+
+void SMMProtocolTest::finishReplay()
+{
+    const quint64 frames = decoder.framesDecoded() - m_replayFirstFrame;
+    const qint64 elapsedMs = replay->elapsedMs();
+    qDebug() << "Replay finished:" << replay->bytesReplayed() << "bytes," << frames << "frames,"
+             << decoder.checksumErrors() - m_replayFirstChecksumError << "checksum errors in" << elapsedMs << "ms";
+
+    decoder.reset();
+    m_waveformStore.setPatient(m_replayPatientId);
+    emit replayFinished(replay->bytesReplayed(), frames, elapsedMs);
+}
+
+void SMMProtocolTest::setEcgLead(int lead)
+{
+    m_ecgLead = qBound(0, lead, EcgBlock::LeadCount - 1);
+}
+
+void SMMProtocolTest::drainEvents()
+{
+    m_drainPending.store(false, std::memory_order_release);
+
+    SMMEvent event;
+    while (m_eventQueue.tryPop(event)) {
+        applyEvent(event);
+    }
+}
 
-            m_waveformSample = waveformRaw;
-            emit waveformSampleReceived();
+void SMMProtocolTest::applyEvent(const SMMEvent &event)
+{
+    switch (event.kind) {
+    case SMMEvent::EcgPacket: {
+        if (m_queuedDelivery.load(std::memory_order_relaxed) && !m_ecgBlockQueue.tryPop(m_ecgBlock))
+            break;
+        // The selected lead goes to the waveform stage, the whole block to ecgBlock()
+        m_ecgSample = m_ecgBlock.samples[m_ecgLead][EcgBlock::SamplesPerLead - 1];
+        stageWaveformSamples(EcgWaveform, m_ecgBlock.samples[m_ecgLead], EcgBlock::SamplesPerLead);
+        emit ecgBlockReceived();
+        break;
+    }
+
+    case SMMEvent::RespSample:
+        m_respSample = event.value;
+        stageWaveformSample(RespWaveform, quint8(event.value));
+        break;
 
-            tryInsertMeasurement();
+    case SMMEvent::PlethSample:
+        m_waveformSample = event.value;
+        stageWaveformSample(PlethWaveform, quint8(event.value));
+        break;
+
+    case SMMEvent::RespirationRate: {
+        QString rrStr = event.value == SMMEvent::Invalid ? "Geçersiz" : QString::number(event.value);
+        m_respirationRate = rrStr;
+        m_cachedResp = rrStr;
+        emit respirationRateChanged();
+
+        tryInsertMeasurement();
+        break;
+    }
+
+    case SMMEvent::Spo2: {
+        QString spo2Str = event.value == SMMEvent::Invalid ? "Geçersiz" : QString::number(event.value);
+        if (spo2Str != m_spo2) {
+            m_spo2 = spo2Str;
+            m_cachedSpO2 = spo2Str;
+            emit spo2Changed();
         }
         break;
     }
 
-    default:
+    case SMMEvent::HeartRate: {
+        QString pulseStr = event.value == SMMEvent::Invalid ? "Geçersiz" : QString::number(event.value);
+        if (pulseStr != m_heartRate) {
+            m_heartRate = pulseStr;
+            m_cachedHeartRate = pulseStr;
+            emit heartRateChanged();
+        }
+
+        tryInsertMeasurement();
         break;
     }
+    }
 }
 
 SMMProtocolTest::SMMProtocolTest(DeviceManager* manager, QObject* parent)
-    : QObject(parent), m_deviceManager(manager)
+    : VitalSource(parent), m_deviceManager(manager)
 {}
 
 void SMMProtocolTest::tryInsertMeasurement()
@@ -409,10 +662,10 @@ void SMMProtocolTest::handleError(QSerialPort::SerialPortError error)
 
     qWarning() << "Serial Port Error:" << error << "-" << serial->errorString();
 
+    // Unplugged: the port is dead until reopened, possibly under another name
     if (error == QSerialPort::ResourceError || error == QSerialPort::DeviceNotFoundError) {
-        if (m_isMonitoring) {
-            connectionSent = false;
-            connectionTimer->start(2000);
-        }
+        closePort();
+        m_waveformStore.close();
+        scheduleReconnect();
     }
 }
@@ -5,36 +5,114 @@
 #include <QSerialPort>
 #include <QSerialPortInfo>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QVariantList>
+#include <array>
 #include <QByteArray>
 #include <QDebug>
 #include <QStringList>
+#include <QByteArrayView>
+#include <atomic>
+#include "smmframedecoder.h"
+#include "smmcapture.h"
+#include "smmportdiscovery.h"
+#include "spscqueue.h"
+#include "vitalsource.h"
+#include "waveformstore.h"
 
 
 class DeviceManager;
 
-class SMMProtocolTest : public QObject
+// One 0x01 packet worth of ECG: 8 samples for each of the 7 leads, lead-major
+struct EcgBlock
 {
-    Q_OBJECT
+    enum Lead { LeadI, LeadII, LeadIII, LeadV, LeadAVR, LeadAVF, LeadAVL };
+
+    static constexpr int LeadCount = 7;
+    static constexpr int SamplesPerLead = 8;
 
-    Q_PROPERTY(QString heartRateValue READ heartRateValue NOTIFY heartRateChanged)
-    Q_PROPERTY(QString spo2Value READ spo2Value NOTIFY spo2Changed)
-    Q_PROPERTY(int waveformSample READ waveformSample NOTIFY waveformSampleReceived)
-    Q_PROPERTY(bool isMonitoring READ isMonitoring NOTIFY monitoringChanged)
-    Q_PROPERTY(int respWaveformSample READ respWaveformSample NOTIFY respWaveformSampleReceived)
-    Q_PROPERTY(int ecgWaveformSample READ ecgWaveformSample NOTIFY ecgWaveformSampleReceived)
-    Q_PROPERTY(QString respirationRate READ respirationRate NOTIFY respirationRateChanged)
+    uint8_t samples[LeadCount][SamplesPerLead];
+    uint8_t flag2;
+};
+
+// Decoded value handed from the parser to the thread that owns the UI state
+struct SMMEvent
+{
+    enum Kind : uint8_t {
+        EcgPacket,
+        PlethSample,
+        RespSample,
+        HeartRate,
+        Spo2,
+        RespirationRate
+    };
+
+    static constexpr int Invalid = -1;
+
+    Kind kind;
+    int value;
+};
+
+class SMMProtocolTest : public VitalSource
+{
+    Q_OBJECT
 
 public:
     SMMProtocolTest(QObject *parent = nullptr);
     ~SMMProtocolTest();
 
-    QString respirationRate() const { return m_respirationRate; }
-    QString heartRateValue() const { return m_heartRate; }
-    QString spo2Value() const { return m_spo2; }
-    int waveformSample() const { return m_waveformSample; }
-    int respWaveformSample() const { return m_respSample; }
-    int ecgWaveformSample() const { return m_ecgSample; }
-    bool isMonitoring() const { return m_isMonitoring; }
+    QString respirationRate() const override { return m_respirationRate; }
+    QString heartRateValue() const override { return m_heartRate; }
+    QString spo2Value() const override { return m_spo2; }
+    int waveformSample() const override { return m_waveformSample; }
+    int respWaveformSample() const override { return m_respSample; }
+    int ecgWaveformSample() const override { return m_ecgSample; }
+    bool isMonitoring() const override { return m_isMonitoring; }
+
+    // Acquisition-thread mode: decoded events are queued instead of applied
+    // in place, and drainEvents() applies them on the consumer (UI) thread
+    void setQueuedDelivery(bool enabled) { m_queuedDelivery.store(enabled); }
+    bool queuedDelivery() const { return m_queuedDelivery.load(); }
+    void drainEvents();
+    int queueDepth() const { return int(m_eventQueue.size()); }
+    quint64 droppedEvents() const { return m_droppedEvents.load(std::memory_order_relaxed); }
+
+    // Waveform events are only delivered while enabled; vitals always are,
+    // and recording is unaffected. Safe to call from any thread.
+    void setWaveformDelivery(bool enabled) { m_waveformDelivery.store(enabled, std::memory_order_relaxed); }
+    bool waveformDelivery() const { return m_waveformDelivery.load(std::memory_order_relaxed); }
+
+    // Serial port to open on start(); empty finds the monitor with
+    // SMMPortDiscovery. Set before monitoring starts.
+    void setPortName(const QString &portName) { m_portName = portName; }
+    QString portName() const { return m_portName; }
+
+    // Milliseconds from opening the port to the first waveform frame of the
+    // current connection, -1 until then. Readable from any thread.
+    qint64 timeToFirstWaveformMs() const { return m_timeToFirstWaveformMs.load(std::memory_order_relaxed); }
+
+    // Data channels the configuration commands turn on, in command order
+    enum DataChannel { EcgChannel, PlethChannel, RespWaveChannel, RespRateChannel, DataChannelCount };
+
+    // Per-channel liveness, readable from any thread: wall-clock time of the
+    // channel's last frame (0 before the first), and how many times the
+    // watchdog has re-sent its command
+    qint64 channelLastSeenMs(int channel) const;
+    quint32 channelRearmCount(int channel) const;
+    QVariantList channelStatus() const; // name, lastSeenMs, rearmCount per channel
+
+    // A complete SMM frame around data; exposed for tools and benchmarks
+    static QByteArray createSMMPacket(uint8_t code, const QByteArray &data);
+
+    // Feeds raw link bytes to the parser as if they had been read from the port
+    void feedBytes(QByteArrayView bytes);
+    bool isReplaying() const { return replay->isRunning(); }
+
+    // Latest full ECG packet (all leads), valid on the consumer thread
+    const EcgBlock &ecgBlock() const { return m_ecgBlock; }
+    int ecgLead() const { return m_ecgLead; }
+    void setEcgLead(int lead);
 
     explicit SMMProtocolTest(DeviceManager* manager, QObject* parent = nullptr);  // ✔️ DeviceManager pointer'ı al
     void tryInsertMeasurement();
@@ -42,56 +120,139 @@ public:
 public slots:
 
     void start();
-    void startMonitoring();
-    void stopMonitoring();
+    void startMonitoring() override;
+    void stopMonitoring() override;
+
+    // Raw waveforms of this device are recorded for the given patient
+    // (empty stops recording); runs on the acquisition thread
+    void setRecordingPatient(const QString &patientId);
+
+    // Writes every chunk read from the port to a capture file (see
+    // SMMCaptureWriter); an empty path stops capturing
+    void setCaptureFile(const QString &path);
+
+    // Plays a capture through the parser instead of the port: speed 1 is
+    // real time, N is N times faster and 0 as fast as possible. Live
+    // acquisition is stopped and waveform recording paused meanwhile.
+    bool startReplay(const QString &path, double speed);
+    void stopReplay();
 
 signals:
 
-    void respirationRateChanged();
-    void heartRateChanged();
-    void spo2Changed();
-    void waveformSampleReceived();
-    void monitoringChanged();
-    void respWaveformSampleReceived();
-    void ecgWaveformSampleReceived();
+    void eventsPending();
+    void ecgBlockReceived();
+    // Also emitted, with zeros, when a replay cannot start
+    void replayFinished(quint64 bytes, quint64 frames, qint64 elapsedMs);
 
 private slots:
 
     void readData();
-    void sendConnectionSequence();
-    void startSequentialRequests();
-    void sendNextPacket();
     void handleError(QSerialPort::SerialPortError error);
+    void commandTimedOut();
+    void checkChannels();
 
 private:
 
     QSerialPort *serial;
-    QTimer *connectionTimer;
-    QTimer *dataRequestTimer;
-    QTimer *sequentialTimer;
+
+    // Link start-up is driven by the device's answers: the handshake goes
+    // out as soon as the port is open, and each command is answered by a
+    // frame of its channel or given up after CommandTimeoutMs. Up to
+    // PipelineDepth commands are outstanding at a time. While streaming, a
+    // watchdog re-sends the command of a channel only once no frame of it
+    // has arrived for that channel's silence limit.
+    enum class LinkState { Closed, Handshake, Configuring, Streaming };
+
+    static constexpr int HandshakeTimeoutMs = 300;
+    static constexpr int CommandTimeoutMs = 250;
+    static constexpr int PipelineDepth = 2;
+    static constexpr int WatchdogIntervalMs = 250;
+
+    struct PendingCommand
+    {
+        int channel;
+        qint64 sentMs;
+    };
+
+    struct ChannelLiveness
+    {
+        qint64 lastSeenClockMs = 0; // m_linkClock times, acquisition thread only
+        qint64 lastArmClockMs = 0;
+        std::atomic<qint64> lastSeenMs{0};
+        std::atomic<quint32> rearmCount{0};
+    };
+
+    LinkState m_linkState = LinkState::Closed;
+    QTimer *commandTimer;
+    QTimer *watchdogTimer;
+    QElapsedTimer m_linkClock;
+    QVector<PendingCommand> m_pendingCommands;
+    int m_nextCommand = 0;
+    std::array<ChannelLiveness, DataChannelCount> m_channels;
+    std::atomic<qint64> m_timeToFirstWaveformMs{-1};
+
+    void sendHandshake();
+    void beginConfiguration();
+    void fillCommandPipeline();
+    void armCommandTimer();
+    void onFrameReceived(uint8_t code);
+
+    // Discovery and reconnection with exponential backoff while monitoring;
+    // the delay is reset once a frame has been decoded
+    static constexpr int InitialReconnectDelayMs = 500;
+    static constexpr int MaxReconnectDelayMs = 30000;
+    SMMPortDiscovery *discovery;
+    QTimer *reconnectTimer;
+    int m_reconnectDelayMs = InitialReconnectDelayMs;
+    void scheduleReconnect();
+    void closePort();
 
     int m_respSample = 0;
     int m_ecgSample = 0;
     QString m_respirationRate;
 
     // Protocol variables
-    QByteArray buffer;
+    SMMFrameDecoder decoder;
     QList<QByteArray> packetCommands;
-    int currentPacketIndex;
-    bool connectionSent = false;
 
     // Status variables
     QString m_heartRate = "0";
     QString m_spo2 = "0";
     int m_waveformSample = 0;
-    bool m_isMonitoring = false;
+    std::atomic_bool m_isMonitoring{false};
+
+    // Producer/consumer handoff for the acquisition thread
+    SpscQueue<SMMEvent, 8192> m_eventQueue;
+    std::atomic_bool m_queuedDelivery{false};
+    std::atomic_bool m_drainPending{false};
+    std::atomic<quint64> m_droppedEvents{0};
+    std::atomic_bool m_waveformDelivery{true};
+    QString m_portName;
+
+    // ECG blocks travel beside the event queue, one block per EcgPacket event
+    SpscQueue<EcgBlock, 256> m_ecgBlockQueue;
+    EcgBlock m_ecgBlock = {};
+    int m_ecgLead = EcgBlock::LeadI;
+
+    // Full-disclosure recording, written by the parser
+    WaveformStore m_waveformStore;
+
+    // Raw capture and replay of the serial link
+    SMMCaptureWriter m_capture;
+    SMMCaptureReplay *replay;
+    QString m_replayPatientId; // Recording patient while a replay runs
+    quint64 m_replayFirstFrame = 0;
+    quint64 m_replayFirstChecksumError = 0;
+    void finishReplay();
 
     // Helper functions
     bool connectToDevice(const QString &portName);
     QList<QByteArray> createIndividualCommands();
-    QByteArray createSMMPacket(uint8_t code, const QByteArray &data);
     void parseBufferedData();
-    void parsePacketByCode(uint8_t code, const QByteArray &payload);
+    void parsePacketByCode(uint8_t code, QByteArrayView payload);
+    void publish(SMMEvent::Kind kind, int value);
+    void publishEcgBlock(QByteArrayView payload);
+    void applyEvent(const SMMEvent &event);
     QByteArray createECGCommandPacket(uint8_t leadCode, uint8_t filterCode, uint8_t gainCode);
 
     // Temporary cache storage
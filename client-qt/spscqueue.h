@@ -0,0 +1,53 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free single-producer/single-consumer queue.
+// tryPush() may only be called from one thread and tryPop() from one other
+// thread. Items are stored inline, nothing is allocated after construction.
+template <typename T, std::size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscQueue capacity must be a power of two");
+
+public:
+    bool tryPush(const T &item)
+    {
+        const std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        m_items[head & (Capacity - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &item)
+    {
+        const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire))
+            return false;
+
+        item = m_items[tail & (Capacity - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently with push/pop
+    std::size_t size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr std::size_t capacity() { return Capacity; }
+
+private:
+    alignas(64) std::atomic<std::size_t> m_head{0}; // Written by the producer
+    alignas(64) std::atomic<std::size_t> m_tail{0}; // Written by the consumer
+    alignas(64) T m_items[Capacity];
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,30 @@
+#include "sqlstatementcache.h"
+
+#include <QSqlError>
+#include <QDebug>
+
+void SqlStatementCache::setDatabase(const QSqlDatabase &database)
+{
+    m_statements.clear();
+    m_failed = QSqlQuery();
+    m_database = database;
+}
+
+QSqlQuery &SqlStatementCache::statement(const QString &sql)
+{
+    auto it = m_statements.find(sql);
+    if (it != m_statements.end()) {
+        // Release the previous result set so the statement can be re-executed
+        it->finish();
+        return *it;
+    }
+
+    QSqlQuery query(m_database);
+    if (!query.prepare(sql)) {
+        qWarning() << "Failed to prepare statement:" << query.lastError().text() << sql;
+        m_failed = query;
+        return m_failed;
+    }
+
+    return *m_statements.insert(sql, query);
+}
@@ -0,0 +1,36 @@
+#ifndef SQLSTATEMENTCACHE_H
+#define SQLSTATEMENTCACHE_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+
+// Per-connection cache of prepared statements.
+// statement() prepares a SQL string the first time it is requested and
+// afterwards hands back the same QSqlQuery, so SQLite compiles each
+// statement once per connection instead of once per call. The returned
+// query must only be used on the thread that owns the connection, and
+// callers must bind every placeholder again before exec(). A statement
+// that fails to prepare is not cached: the failed query is returned (its
+// exec() fails with the prepare error) and the next call prepares again.
+class SqlStatementCache
+{
+public:
+    SqlStatementCache() = default;
+    explicit SqlStatementCache(const QSqlDatabase &database) : m_database(database) {}
+
+    // Drops all cached statements; call before the connection is closed
+    void setDatabase(const QSqlDatabase &database);
+    void clear() { m_statements.clear(); m_failed = QSqlQuery(); }
+
+    QSqlQuery &statement(const QString &sql);
+    int size() const { return int(m_statements.size()); }
+
+private:
+    QSqlDatabase m_database;
+    QHash<QString, QSqlQuery> m_statements;
+    QSqlQuery m_failed; // Last statement that failed to prepare
+};
+
+#endif // SQLSTATEMENTCACHE_H
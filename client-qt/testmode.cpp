@@ -1,7 +1,7 @@
 #include "testmode.h"
 #include "devicemanager.h"
 
-testmode::testmode(QObject *parent) : QObject(parent)
+testmode::testmode(QObject *parent) : VitalSource(parent)
 {
     testModeTimer = new QTimer(this);
     connect(testModeTimer, &QTimer::timeout, this, &testmode::generateTestData);
@@ -111,9 +111,9 @@ void testmode::generateTestData()
     m_respWaveformSample = generateRespWaveform();
     m_ecgWaveformSample = generateECGWaveform();
 
-    emit waveformSampleReceived();
-    emit respWaveformSampleReceived();
-    emit ecgWaveformSampleReceived();
+    stageWaveformSample(PlethWaveform, quint8(m_waveformSample));
+    stageWaveformSample(RespWaveform, quint8(m_respWaveformSample));
+    stageWaveformSample(EcgWaveform, quint8(m_ecgWaveformSample));
 
     testDataIndex++;
 
@@ -6,49 +6,36 @@
 #include <QSerialPort>
 #include <QRandomGenerator>
 #include <QDebug>
+#include "vitalsource.h"
 
 
-class testmode : public QObject
+class testmode : public VitalSource
 {
     Q_OBJECT
 
     Q_PROPERTY(bool testMode READ testMode WRITE setTestMode NOTIFY testModeChanged)
-    Q_PROPERTY(QString heartRateValue READ heartRateValue NOTIFY heartRateChanged)
-    Q_PROPERTY(QString spo2Value READ spo2Value NOTIFY spo2Changed)
-    Q_PROPERTY(int waveformSample READ waveformSample NOTIFY waveformSampleReceived)
-    Q_PROPERTY(bool isMonitoring READ isMonitoring NOTIFY monitoringChanged)
-    Q_PROPERTY(int respWaveformSample READ respWaveformSample NOTIFY respWaveformSampleReceived)
-    Q_PROPERTY(int ecgWaveformSample READ ecgWaveformSample NOTIFY ecgWaveformSampleReceived)
-    Q_PROPERTY(QString respirationRate READ respirationRate NOTIFY respirationRateChanged)
 
 public:
     explicit testmode(QObject *parent = nullptr);
 
-    QString respirationRate() const { return m_respirationRate; }
-    QString heartRateValue() const { return m_heartRate; }
-    QString spo2Value() const { return m_spo2; }
-    int waveformSample() const { return m_waveformSample; }
-    bool isMonitoring() const { return m_isMonitoring; }
-    int respWaveformSample() const { return m_respWaveformSample; }
-    int ecgWaveformSample() const { return m_ecgWaveformSample; }
+    QString respirationRate() const override { return m_respirationRate; }
+    QString heartRateValue() const override { return m_heartRate; }
+    QString spo2Value() const override { return m_spo2; }
+    int waveformSample() const override { return m_waveformSample; }
+    bool isMonitoring() const override { return m_isMonitoring; }
+    int respWaveformSample() const override { return m_respWaveformSample; }
+    int ecgWaveformSample() const override { return m_ecgWaveformSample; }
     bool testMode() const { return m_testMode; }
 
 public slots:
 
     void setTestMode(bool enabled);
-    void startMonitoring();
-    void stopMonitoring();
+    void startMonitoring() override;
+    void stopMonitoring() override;
 
 signals:
 
     void testModeChanged();
-    void heartRateChanged();
-    void spo2Changed();
-    void waveformSampleReceived();
-    void monitoringChanged();
-    void respWaveformSampleReceived();
-    void ecgWaveformSampleReceived();
-    void respirationRateChanged();
 
 private slots:
 
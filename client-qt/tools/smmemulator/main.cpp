@@ -0,0 +1,107 @@
+// SMM monitor emulator on a pseudo-terminal, for running the client without
+// hardware, for load tests at raised frame rates and for corrupt-frame tests.
+// Usage: smmemulator [--link /tmp/smm0] [--ecg-rate 62.5] [--corrupt 0.01] ...
+// Point the client at the printed slave path (or the link).
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QTextStream>
+#include <QTimer>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include "smmemulator.h"
+
+static int g_signalPipe[2] = {-1, -1};
+
+// Only async-signal-safe calls here: the event loop quits once the pipe is readable
+static void handleSignal(int)
+{
+    const char byte = 1;
+    [[maybe_unused]] const ssize_t written = ::write(g_signalPipe[1], &byte, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("smmemulator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("SMM monitor emulator on a pseudo-terminal");
+    parser.addHelpOption();
+
+    const QCommandLineOption link("link", "Symlink to the slave tty.", "path");
+    const QCommandLineOption ecgRate("ecg-rate", "ECG frames per second.", "rate", "62.5");
+    const QCommandLineOption plethRate("pleth-rate", "Pleth/SpO2 frames per second.", "rate", "50");
+    const QCommandLineOption respRate("resp-rate", "Resp waveform frames per second.", "rate", "25");
+    const QCommandLineOption rrRate("rr-rate", "Resp rate frames per second.", "rate", "1");
+    const QCommandLineOption corrupt("corrupt", "Fraction of frames to damage (0..1).", "fraction", "0");
+    const QCommandLineOption noReply("no-handshake-reply", "Do not answer the handshake.");
+    const QCommandLineOption immediate("stream-immediately", "Stream without waiting for requests.");
+    const QCommandLineOption hr("hr", "Heart rate.", "bpm", "72");
+    const QCommandLineOption spo2("spo2", "SpO2.", "percent", "98");
+    const QCommandLineOption rr("rr", "Respiration rate.", "rpm", "16");
+    const QCommandLineOption duration("duration", "Exit after this many seconds.", "seconds", "0");
+    parser.addOptions({link, ecgRate, plethRate, respRate, rrRate, corrupt, noReply, immediate,
+                       hr, spo2, rr, duration});
+    parser.process(app);
+
+    SMMEmulator::Options options;
+    options.linkPath = parser.value(link);
+    options.rates[SMMEmulator::Ecg] = parser.value(ecgRate).toDouble();
+    options.rates[SMMEmulator::Pleth] = parser.value(plethRate).toDouble();
+    options.rates[SMMEmulator::RespWave] = parser.value(respRate).toDouble();
+    options.rates[SMMEmulator::RespRate] = parser.value(rrRate).toDouble();
+    options.corruptionRate = qBound(0.0, parser.value(corrupt).toDouble(), 1.0);
+    options.answerHandshake = !parser.isSet(noReply);
+    options.waitForRequests = !parser.isSet(immediate);
+    options.heartRate = parser.value(hr).toInt();
+    options.spo2 = parser.value(spo2).toInt();
+    options.respRate = parser.value(rr).toInt();
+
+    QTextStream out(stdout);
+    SMMEmulator emulator(options);
+    QString error;
+    if (!emulator.open(&error)) {
+        QTextStream(stderr) << error << Qt::endl;
+        return 1;
+    }
+    out << "Slave tty: " << emulator.slavePath();
+    if (!options.linkPath.isEmpty())
+        out << " (" << options.linkPath << ")";
+    out << Qt::endl;
+
+    // Let Ctrl+C run the destructor so the link is removed
+    if (::pipe(g_signalPipe) != 0) {
+        QTextStream(stderr) << "pipe() failed" << Qt::endl;
+        return 1;
+    }
+    fcntl(g_signalPipe[1], F_SETFL, fcntl(g_signalPipe[1], F_GETFL) | O_NONBLOCK);
+    QSocketNotifier signalNotifier(g_signalPipe[0], QSocketNotifier::Read);
+    QObject::connect(&signalNotifier, &QSocketNotifier::activated, &app, &QCoreApplication::quit);
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    QTimer statsTimer;
+    SMMEmulator::Stats last;
+    QObject::connect(&statsTimer, &QTimer::timeout, [&]() {
+        const SMMEmulator::Stats &stats = emulator.stats();
+        out << QString("frames/s %1  KiB/s %2  corrupted %3  overruns %4  handshakes %5  requests %6")
+                   .arg(stats.frames - last.frames)
+                   .arg((stats.bytes - last.bytes) / 1024.0, 0, 'f', 1)
+                   .arg(stats.corrupted)
+                   .arg(stats.overruns)
+                   .arg(stats.handshakes)
+                   .arg(stats.requests)
+            << Qt::endl;
+        last = stats;
+    });
+    statsTimer.start(1000);
+
+    const int seconds = parser.value(duration).toInt();
+    if (seconds > 0)
+        QTimer::singleShot(seconds * 1000, &app, &QCoreApplication::quit);
+
+    return app.exec();
+}
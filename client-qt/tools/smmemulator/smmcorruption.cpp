@@ -0,0 +1,29 @@
+#include "smmcorruption.h"
+#include "smmframedecoder.h"
+
+QByteArray SMM::corruptFrame(QByteArray frame, QRandomGenerator &random)
+{
+    switch (random.bounded(3)) {
+    case 0: {
+        // Checksum error: one flipped bit after the sync bytes
+        const int at = 2 + random.bounded(int(frame.size()) - 2);
+        frame[at] = char(frame.at(at) ^ (1 << random.bounded(8)));
+        break;
+    }
+    case 1:
+        // Frame cut short, the next frame's bytes follow
+        frame.truncate(1 + random.bounded(int(frame.size()) - 1));
+        break;
+    default: {
+        // Line noise ahead of the frame, sometimes a false sync byte
+        QByteArray noise(1 + random.bounded(8), Qt::Uninitialized);
+        for (char &byte : noise)
+            byte = char(random.bounded(256));
+        if (random.bounded(2))
+            noise[0] = char(SMM::SyncByte1);
+        frame.prepend(noise);
+        break;
+    }
+    }
+    return frame;
+}
@@ -0,0 +1,17 @@
+#ifndef SMMCORRUPTION_H
+#define SMMCORRUPTION_H
+
+#include <QByteArray>
+#include <QRandomGenerator>
+
+// Frame damage as a noisy serial line causes it, shared by the emulator's
+// corrupt-frame injection and the parser benchmark's noisy traffic.
+namespace SMM {
+
+// Damages a complete frame one of three ways, picked at random: a flipped
+// bit after the sync bytes, a cut-off tail, or garbage (sometimes a false
+// sync byte) ahead of it
+QByteArray corruptFrame(QByteArray frame, QRandomGenerator &random);
+}
+
+#endif // SMMCORRUPTION_H
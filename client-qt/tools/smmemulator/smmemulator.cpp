@@ -0,0 +1,281 @@
+#include "smmemulator.h"
+#include "smmcorruption.h"
+#include <QDebug>
+#include <QFile>
+#include <cerrno>
+#include <cmath>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+static const uint8_t Handshake[] = {0xBF, 0x5F, 0xFF};
+
+// Request code that turns each stream on, and the code of its frames
+static const uint8_t RequestCodes[SMMEmulator::StreamCount] = {0x01, 0x02, 0x03, 0x04};
+static const uint8_t FrameCodes[SMMEmulator::StreamCount] = {0x01, 0x15, 0x03, 0x04};
+
+SMMEmulator::SMMEmulator(const Options &options, QObject *parent)
+    : QObject(parent)
+    , m_options(options)
+    , m_random(QRandomGenerator::securelySeeded())
+{
+    m_tickTimer = new QTimer(this);
+    m_tickTimer->setTimerType(Qt::PreciseTimer);
+    m_tickTimer->setInterval(TickMs);
+    connect(m_tickTimer, &QTimer::timeout, this, &SMMEmulator::tick);
+}
+
+SMMEmulator::~SMMEmulator()
+{
+    if (!m_options.linkPath.isEmpty())
+        QFile::remove(m_options.linkPath);
+    if (m_slave >= 0)
+        ::close(m_slave);
+    if (m_master >= 0)
+        ::close(m_master);
+}
+
+bool SMMEmulator::open(QString *error)
+{
+    m_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (m_master < 0 || grantpt(m_master) != 0 || unlockpt(m_master) != 0) {
+        *error = QString("Cannot create a pseudo-terminal: %1").arg(strerror(errno));
+        return false;
+    }
+    m_slavePath = QString::fromLocal8Bit(ptsname(m_master));
+
+    // Raw line discipline; the client sets its own settings again on open
+    m_slave = ::open(ptsname(m_master), O_RDWR | O_NOCTTY);
+    if (m_slave < 0) {
+        *error = QString("Cannot open %1: %2").arg(m_slavePath, strerror(errno));
+        return false;
+    }
+    termios tty;
+    if (tcgetattr(m_slave, &tty) == 0) {
+        cfmakeraw(&tty);
+        tcsetattr(m_slave, TCSANOW, &tty);
+    }
+    fcntl(m_master, F_SETFL, fcntl(m_master, F_GETFL) | O_NONBLOCK);
+
+    if (!m_options.linkPath.isEmpty()) {
+        QFile::remove(m_options.linkPath);
+        if (!QFile::link(m_slavePath, m_options.linkPath)) {
+            *error = QString("Cannot create the link %1").arg(m_options.linkPath);
+            return false;
+        }
+    }
+
+    m_readNotifier = new QSocketNotifier(m_master, QSocketNotifier::Read, this);
+    connect(m_readNotifier, &QSocketNotifier::activated, this, &SMMEmulator::readInput);
+    m_writeNotifier = new QSocketNotifier(m_master, QSocketNotifier::Write, this);
+    m_writeNotifier->setEnabled(false);
+    connect(m_writeNotifier, &QSocketNotifier::activated, this, &SMMEmulator::flushOutput);
+
+    m_clock.start();
+    if (!m_options.waitForRequests) {
+        for (int stream = 0; stream < StreamCount; ++stream)
+            startStream(Stream(stream));
+    }
+    m_tickTimer->start();
+    return true;
+}
+
+QByteArray SMMEmulator::frame(uint8_t code, const QByteArray &payload)
+{
+    QByteArray packet;
+    packet.reserve(SMM::HeaderSize + payload.size() + 1);
+    const uint8_t length = uint8_t(payload.size() + 1);
+    packet.append(char(SMM::SyncByte1));
+    packet.append(char(SMM::SyncByte2));
+    packet.append(char(length));
+    packet.append(char(code));
+    packet.append(payload);
+    packet.append(char(SMM::checksum(reinterpret_cast<const uint8_t *>(payload.constData()),
+                                     int(payload.size()), uint8_t(length + code))));
+    return packet;
+}
+
+void SMMEmulator::readInput()
+{
+    char buffer[512];
+    for (;;) {
+        const ssize_t count = ::read(m_master, buffer, sizeof(buffer));
+        if (count <= 0)
+            break; // EAGAIN, or EIO while no client has the slave open
+
+        for (ssize_t i = 0; i < count; ++i) {
+            const uint8_t byte = uint8_t(buffer[i]);
+            if (byte == Handshake[m_handshakeMatched]) {
+                if (++m_handshakeMatched < int(sizeof(Handshake)))
+                    continue;
+
+                // A new session: streams wait for their requests again
+                m_handshakeMatched = 0;
+                ++m_stats.handshakes;
+                if (m_options.waitForRequests) {
+                    for (bool &enabled : m_enabled)
+                        enabled = false;
+                }
+                if (m_options.answerHandshake)
+                    send(frame(FrameCodes[RespRate], nextPayload(RespRate)));
+            } else {
+                m_handshakeMatched = byte == Handshake[0] ? 1 : 0;
+            }
+        }
+
+        // Requests are ordinary SMM frames; the handshake bytes are skipped as noise
+        m_decoder.ring().append(buffer, quint32(count));
+        SMMFrameDecoder::Frame request;
+        while (m_decoder.next(request))
+            handleRequest(request.code);
+    }
+}
+
+void SMMEmulator::handleRequest(uint8_t code)
+{
+    for (int stream = 0; stream < StreamCount; ++stream) {
+        if (RequestCodes[stream] != code)
+            continue;
+
+        ++m_stats.requests;
+        // The first frame of the stream is the answer
+        if (!m_enabled[stream])
+            startStream(Stream(stream));
+        send(frame(FrameCodes[stream], nextPayload(Stream(stream))));
+        return;
+    }
+    qDebug() << "Unknown request" << Qt::hex << code;
+}
+
+void SMMEmulator::startStream(Stream stream)
+{
+    m_enabled[stream] = true;
+    m_streamStartMs[stream] = m_clock.elapsed();
+    m_streamFrames[stream] = 0;
+}
+
+void SMMEmulator::tick()
+{
+    const qint64 now = m_clock.elapsed();
+    for (int stream = 0; stream < StreamCount; ++stream) {
+        if (!m_enabled[stream] || m_options.rates[stream] <= 0)
+            continue;
+
+        const double rate = m_options.rates[stream];
+        quint64 due = quint64((now - m_streamStartMs[stream]) * rate / 1000.0);
+
+        // More than a second behind (the process was stalled): skip ahead
+        if (due > m_streamFrames[stream] + quint64(rate) + 1)
+            m_streamFrames[stream] = due - quint64(rate);
+
+        for (; m_streamFrames[stream] < due; ++m_streamFrames[stream])
+            send(frame(FrameCodes[stream], nextPayload(Stream(stream))));
+    }
+}
+
+void SMMEmulator::send(const QByteArray &frame)
+{
+    QByteArray bytes = frame;
+    if (m_options.corruptionRate > 0 && m_random.generateDouble() < m_options.corruptionRate) {
+        bytes = SMM::corruptFrame(bytes, m_random);
+        ++m_stats.corrupted;
+    }
+
+    if (m_output.size() + bytes.size() > MaxPendingBytes) {
+        ++m_stats.overruns;
+        return;
+    }
+
+    m_output.append(bytes);
+    ++m_stats.frames;
+    flushOutput();
+}
+
+void SMMEmulator::flushOutput()
+{
+    while (!m_output.isEmpty()) {
+        const ssize_t written = ::write(m_master, m_output.constData(), size_t(m_output.size()));
+        if (written <= 0)
+            break;
+        m_stats.bytes += quint64(written);
+        m_output.remove(0, qsizetype(written));
+    }
+    m_writeNotifier->setEnabled(!m_output.isEmpty());
+}
+
+// Sum of Gaussian P, Q, R, S and T waves over one beat, scaled per lead
+int SMMEmulator::ecgSample(int lead, quint64 sample) const
+{
+    static const double LeadGain[7] = {1.0, 1.3, 0.4, 0.9, -0.8, 0.7, 0.5};
+    struct Wave { double amplitude, center, width; };
+    static const Wave Waves[] = {
+        {0.12, 0.20, 0.025}, {-0.10, 0.37, 0.010}, {1.00, 0.40, 0.012},
+        {-0.25, 0.43, 0.012}, {0.30, 0.65, 0.050}
+    };
+
+    const double sampleRate = qMax(1.0, m_options.rates[Ecg]) * 8.0;
+    const double period = 60.0 / qMax(1, m_options.heartRate);
+    const double phase = std::fmod(sample / sampleRate, period) / period;
+
+    double value = 0;
+    for (const Wave &wave : Waves) {
+        const double d = (phase - wave.center) / wave.width;
+        value += wave.amplitude * std::exp(-0.5 * d * d);
+    }
+    return qBound(0, int(128 + 90 * LeadGain[lead] * value), 255);
+}
+
+QByteArray SMMEmulator::nextPayload(Stream stream)
+{
+    const quint64 sample = m_samples[stream];
+    QByteArray payload;
+
+    switch (stream) {
+    case Ecg:
+        // 7 leads x 8 samples, lead-major, then FLAG2
+        payload.resize(57);
+        for (int lead = 0; lead < 7; ++lead) {
+            for (int i = 0; i < 8; ++i)
+                payload[lead * 8 + i] = char(ecgSample(lead, sample + quint64(i)));
+        }
+        payload[56] = 0;
+        m_samples[stream] += 8;
+        break;
+
+    case Pleth: {
+        const double period = 60.0 / qMax(1, m_options.heartRate);
+        const double phase = std::fmod(sample / qMax(1.0, m_options.rates[Pleth]), period) / period;
+        const double systole = std::exp(-0.5 * std::pow((phase - 0.25) / 0.08, 2));
+        const double notch = std::exp(-0.5 * std::pow((phase - 0.55) / 0.07, 2));
+        const int pulse = m_options.heartRate;
+        payload.resize(6);
+        payload[0] = 0;
+        payload[1] = char(qBound(0, int(40 + 170 * systole + 45 * notch), 255));
+        payload[2] = 0;
+        payload[3] = char(m_options.spo2);
+        payload[4] = char(pulse >> 8);
+        payload[5] = char(pulse & 0xFF);
+        m_samples[stream] += 1;
+        break;
+    }
+
+    case RespWave: {
+        const double t = sample / qMax(1.0, m_options.rates[RespWave]);
+        payload.resize(1);
+        payload[0] = char(qBound(0, int(128 + 80 * std::sin(2 * M_PI * t * m_options.respRate / 60.0)), 255));
+        m_samples[stream] += 1;
+        break;
+    }
+
+    case RespRate:
+        payload = QByteArray(6, 0);
+        payload[4] = char(m_options.respRate);
+        m_samples[stream] += 1;
+        break;
+
+    default:
+        break;
+    }
+    return payload;
+}
@@ -0,0 +1,105 @@
+#ifndef SMMEMULATOR_H
+#define SMMEMULATOR_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QRandomGenerator>
+#include <QSocketNotifier>
+#include <QString>
+#include <QTimer>
+#include "smmframedecoder.h"
+
+// An SMM monitor on the master side of a pseudo-terminal.
+//
+// The slave side is an ordinary tty that SMMProtocolTest opens like the USB
+// adapter (setPortName() or a --link symlink). Like the device, the
+// emulator answers the BF5FFF handshake and turns on one stream per
+// request: 0x01 ECG (0x01 frames, 8 samples per lead), 0x02 pleth/SpO2
+// (0x15), 0x03 resp waveform (0x03) and 0x04 resp rate (0x04). Streams are
+// paced against a monotonic clock at the configured frame rates, so rates
+// well above the real device's are possible for load tests. A fraction of
+// the frames can be damaged on the way out (bit flips, truncation, leading
+// garbage) to exercise resynchronisation.
+//
+// Output is non-blocking. Frames that do not fit while nobody reads the
+// slave are dropped and counted, as on a UART without flow control.
+class SMMEmulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Stream { Ecg, Pleth, RespWave, RespRate, StreamCount };
+
+    struct Options
+    {
+        double rates[StreamCount] = {62.5, 50.0, 25.0, 1.0}; // Frames per second
+        double corruptionRate = 0.0; // Fraction of frames damaged
+        bool answerHandshake = true;
+        bool waitForRequests = true; // Otherwise every stream runs from the start
+        int heartRate = 72;
+        int spo2 = 98;
+        int respRate = 16;
+        QString linkPath; // Symlink to the slave, replaced if present
+    };
+
+    struct Stats
+    {
+        quint64 frames = 0;
+        quint64 bytes = 0;
+        quint64 corrupted = 0;
+        quint64 overruns = 0;
+        quint64 handshakes = 0;
+        quint64 requests = 0;
+    };
+
+    static constexpr int TickMs = 2;
+    static constexpr int MaxPendingBytes = 256 * 1024;
+
+    explicit SMMEmulator(const Options &options, QObject *parent = nullptr);
+    ~SMMEmulator();
+
+    // Creates the pty pair and starts answering; false with a message on failure
+    bool open(QString *error);
+    QString slavePath() const { return m_slavePath; }
+    const Stats &stats() const { return m_stats; }
+
+    // A complete SMM frame with header and checksum
+    static QByteArray frame(uint8_t code, const QByteArray &payload);
+
+    // Next frame payload of a stream; advances its synthetic signal
+    QByteArray nextPayload(Stream stream);
+
+private:
+    void readInput();
+    void handleRequest(uint8_t code);
+    void tick();
+    void startStream(Stream stream);
+    void send(const QByteArray &frame);
+    void flushOutput();
+
+    int ecgSample(int lead, quint64 sample) const;
+
+    Options m_options;
+    int m_master = -1;
+    int m_slave = -1; // Held open so the master never sees a hang-up
+    QString m_slavePath;
+    QSocketNotifier *m_readNotifier = nullptr;
+    QSocketNotifier *m_writeNotifier = nullptr;
+    QTimer *m_tickTimer;
+    QElapsedTimer m_clock;
+    QRandomGenerator m_random;
+
+    SMMFrameDecoder m_decoder;
+    int m_handshakeMatched = 0;
+    QByteArray m_output;
+
+    bool m_enabled[StreamCount] = {};
+    qint64 m_streamStartMs[StreamCount] = {};
+    quint64 m_streamFrames[StreamCount] = {};
+    quint64 m_samples[StreamCount] = {};
+
+    Stats m_stats;
+};
+
+#endif // SMMEMULATOR_H
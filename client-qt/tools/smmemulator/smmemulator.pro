@@ -0,0 +1,22 @@
+QT += core
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = smmemulator
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    main.cpp \
+    smmemulator.cpp \
+    smmcorruption.cpp \
+    ../../smmframedecoder.cpp \
+    ../../smmkernels.cpp
+
+HEADERS += \
+    smmemulator.h \
+    smmcorruption.h \
+    ../../smmframedecoder.h \
+    ../../smmkernels.h
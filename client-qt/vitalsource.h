@@ -0,0 +1,105 @@
+#ifndef VITALSOURCE_H
+#define VITALSOURCE_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+// Common interface of the devices DeviceManager can read vitals from
+// (the SMM serial monitor and the test-mode generator). Accessors are plain
+// virtual calls, so consumers need neither QObject::property() lookups nor
+// string-based connections.
+//
+// Waveform samples are not signalled one by one: the source stages them per
+// channel and emits waveformSamplesPending once when the stage stops being
+// empty. The consumer collects everything staged so far with
+// takeWaveformBatch(), e.g. once per displayed frame. Staging and taking
+// happen on the thread the UI state lives on.
+class VitalSource : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString heartRateValue READ heartRateValue NOTIFY heartRateChanged)
+    Q_PROPERTY(QString spo2Value READ spo2Value NOTIFY spo2Changed)
+    Q_PROPERTY(QString respirationRate READ respirationRate NOTIFY respirationRateChanged)
+    Q_PROPERTY(int waveformSample READ waveformSample NOTIFY waveformSamplesPending)
+    Q_PROPERTY(int respWaveformSample READ respWaveformSample NOTIFY waveformSamplesPending)
+    Q_PROPERTY(int ecgWaveformSample READ ecgWaveformSample NOTIFY waveformSamplesPending)
+    Q_PROPERTY(bool isMonitoring READ isMonitoring NOTIFY monitoringChanged)
+
+public:
+    using QObject::QObject;
+
+    enum WaveformChannel { EcgWaveform, PlethWaveform, RespWaveform, WaveformChannelCount };
+
+    // New samples of every channel, oldest first
+    struct WaveformBatch
+    {
+        QVector<quint8> samples[WaveformChannelCount];
+
+        bool isEmpty() const
+        {
+            for (const QVector<quint8> &channel : samples) {
+                if (!channel.isEmpty())
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    // Hands the staged samples over to batch, replacing its contents. The
+    // vectors are swapped, so both sides keep their capacity.
+    void takeWaveformBatch(WaveformBatch &batch)
+    {
+        for (int channel = 0; channel < WaveformChannelCount; ++channel) {
+            batch.samples[channel].clear();
+            batch.samples[channel].swap(m_stagedSamples.samples[channel]);
+        }
+        m_samplesPending = false;
+    }
+
+    virtual QString heartRateValue() const = 0;
+    virtual QString spo2Value() const = 0;
+    virtual QString respirationRate() const = 0;
+    virtual int waveformSample() const = 0;
+    virtual int respWaveformSample() const = 0;
+    virtual int ecgWaveformSample() const = 0;
+    virtual bool isMonitoring() const = 0;
+
+public slots:
+
+    virtual void startMonitoring() = 0;
+    virtual void stopMonitoring() = 0;
+
+signals:
+
+    void heartRateChanged();
+    void spo2Changed();
+    void respirationRateChanged();
+    void waveformSamplesPending();
+    void monitoringChanged();
+
+protected:
+    void stageWaveformSamples(WaveformChannel channel, const quint8 *samples, int count)
+    {
+        QVector<quint8> &staged = m_stagedSamples.samples[channel];
+        for (int i = 0; i < count; ++i)
+            staged.append(samples[i]);
+
+        if (!m_samplesPending && count > 0) {
+            m_samplesPending = true;
+            emit waveformSamplesPending();
+        }
+    }
+
+    void stageWaveformSample(WaveformChannel channel, quint8 sample)
+    {
+        stageWaveformSamples(channel, &sample, 1);
+    }
+
+private:
+    WaveformBatch m_stagedSamples;
+    bool m_samplesPending = false;
+};
+
+#endif // VITALSOURCE_H
@@ -0,0 +1,92 @@
+#include "waveformbuffer.h"
+
+WaveformBuffer::WaveformBuffer(QObject *parent) : WaveformBuffer(1024, parent)
+{}
+
+WaveformBuffer::WaveformBuffer(int capacity, QObject *parent)
+    : QObject(parent), m_samples(qMax(1, capacity), 0)
+{}
+
+void WaveformBuffer::setCapacity(int capacity)
+{
+    capacity = qMax(1, capacity);
+    if (capacity == m_samples.size())
+        return;
+
+    // Keep the newest samples that still fit, at the same absolute indices
+    QVector<Sample> resized(capacity, 0);
+    qint64 from = qMax<qint64>(firstIndex(), m_writeCursor - capacity);
+    for (qint64 i = from; i < m_writeCursor; ++i)
+        resized[i % capacity] = m_samples[i % m_samples.size()];
+
+    m_samples.swap(resized);
+    emit capacityChanged();
+}
+
+void WaveformBuffer::append(Sample sample)
+{
+    m_samples[m_writeCursor % m_samples.size()] = sample;
+    ++m_writeCursor;
+    emit samplesAppended();
+}
+
+void WaveformBuffer::append(const Sample *samples, int count)
+{
+    if (count <= 0)
+        return;
+
+    const int size = m_samples.size();
+    Sample *data = m_samples.data();
+    for (int i = 0; i < count; ++i)
+        data[(m_writeCursor + i) % size] = samples[i];
+
+    m_writeCursor += count;
+    emit samplesAppended();
+}
+
+int WaveformBuffer::read(qint64 from, Sample *out, int count) const
+{
+    from = qMax(from, firstIndex());
+    qint64 to = qMin(from + count, m_writeCursor);
+    if (to <= from)
+        return 0;
+
+    const int size = m_samples.size();
+    const Sample *data = m_samples.constData();
+    for (qint64 i = from; i < to; ++i)
+        *out++ = data[i % size];
+    return int(to - from);
+}
+
+int WaveformBuffer::sampleAt(qint64 index) const
+{
+    if (index < firstIndex() || index >= m_writeCursor)
+        return 0;
+    return m_samples[index % m_samples.size()];
+}
+
+QVariantList WaveformBuffer::samples(qint64 from, int count) const
+{
+    QVariantList result;
+    from = qMax(from, firstIndex());
+    qint64 to = qMin(from + count, m_writeCursor);
+    if (to <= from)
+        return result;
+
+    result.reserve(int(to - from));
+    for (qint64 i = from; i < to; ++i)
+        result.append(int(m_samples[i % m_samples.size()]));
+    return result;
+}
+
+QVariantList WaveformBuffer::latest(int count) const
+{
+    return samples(m_writeCursor - count, count);
+}
+
+void WaveformBuffer::clear()
+{
+    m_samples.fill(0);
+    m_writeCursor = 0;
+    emit samplesAppended();
+}
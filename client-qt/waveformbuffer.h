@@ -0,0 +1,56 @@
+#ifndef WAVEFORMBUFFER_H
+#define WAVEFORMBUFFER_H
+
+#include <QObject>
+#include <QQmlEngine>
+#include <QVariantList>
+#include <QVector>
+
+// Fixed-capacity circular buffer of waveform samples.
+// Samples are addressed by absolute index: writeCursor is the index the
+// next sample will get, and the last capacity samples stay readable, i.e.
+// [firstIndex, writeCursor). Filled by DeviceManager on the UI thread, one
+// batch per displayed frame, and read by the QML/C++ renderers by index range.
+class WaveformBuffer : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(int capacity READ capacity WRITE setCapacity NOTIFY capacityChanged)
+    Q_PROPERTY(qint64 writeCursor READ writeCursor NOTIFY samplesAppended)
+    Q_PROPERTY(qint64 firstIndex READ firstIndex NOTIFY samplesAppended)
+
+public:
+    using Sample = quint8;
+
+    explicit WaveformBuffer(QObject *parent = nullptr);
+    WaveformBuffer(int capacity, QObject *parent);
+
+    int capacity() const { return m_samples.size(); }
+    void setCapacity(int capacity);
+
+    qint64 writeCursor() const { return m_writeCursor; }
+    qint64 firstIndex() const { return qMax<qint64>(0, m_writeCursor - m_samples.size()); }
+
+    void append(Sample sample);
+    void append(const Sample *samples, int count);
+
+    // Copies up to count samples starting at absolute index from; returns the number copied
+    int read(qint64 from, Sample *out, int count) const;
+
+    Q_INVOKABLE int sampleAt(qint64 index) const;
+    Q_INVOKABLE QVariantList samples(qint64 from, int count) const;
+    Q_INVOKABLE QVariantList latest(int count) const;
+    Q_INVOKABLE void clear();
+
+signals:
+
+    void capacityChanged();
+    void samplesAppended();
+
+private:
+    QVector<Sample> m_samples;
+    qint64 m_writeCursor = 0;
+};
+
+#endif // WAVEFORMBUFFER_H
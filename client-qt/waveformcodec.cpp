@@ -0,0 +1,52 @@
+#include "waveformcodec.h"
+
+namespace WaveformCodec {
+
+int encode(const quint8 *samples, int count, quint8 *out)
+{
+    quint8 *p = out;
+    int previous = 0;
+
+    for (int i = 0; i < count; ++i) {
+        const int delta = int(samples[i]) - previous;
+        const quint32 zigzag = quint32((delta << 1) ^ (delta >> 31));
+        previous = samples[i];
+
+        if (zigzag < 0x80) {
+            *p++ = quint8(zigzag);
+        } else {
+            *p++ = quint8(zigzag | 0x80);
+            *p++ = quint8(zigzag >> 7);
+        }
+    }
+
+    return int(p - out);
+}
+
+int decode(const quint8 *in, int size, quint8 *out, int count)
+{
+    const quint8 *p = in;
+    const quint8 *end = in + size;
+    int previous = 0;
+
+    for (int i = 0; i < count; ++i) {
+        if (p == end)
+            return -1;
+
+        quint32 zigzag = *p++;
+        if (zigzag & 0x80) {
+            if (p == end || (*p & 0x80))
+                return -1;
+            zigzag = (zigzag & 0x7F) | (quint32(*p++) << 7);
+        }
+
+        const int delta = int(zigzag >> 1) ^ -int(zigzag & 1);
+        previous += delta;
+        if (previous < 0 || previous > 0xFF)
+            return -1;
+        out[i] = quint8(previous);
+    }
+
+    return int(p - in);
+}
+}
@@ -0,0 +1,24 @@
+#ifndef WAVEFORMCODEC_H
+#define WAVEFORMCODEC_H
+
+#include <QtGlobal>
+
+// Lossless coding of 8-bit waveform samples for the waveform store.
+// Each sample is stored as the zigzag-mapped difference to the previous
+// one (the first against 0), written as a little-endian base-128 varint.
+// Differences of a smooth trace fall in [-63, 63] and take one byte; the
+// worst case is two bytes per sample.
+namespace WaveformCodec {
+
+constexpr int maxEncodedSize(int count) { return count * 2; }
+
+// out must hold at least maxEncodedSize(count) bytes; returns the number of
+// bytes written, which is at most maxEncodedSize(count)
+int encode(const quint8 *samples, int count, quint8 *out);
+
+// Decodes count samples from in; returns the number of bytes consumed, or
+// -1 if the input is truncated or malformed
+int decode(const quint8 *in, int size, quint8 *out, int count);
+}
+
+#endif // WAVEFORMCODEC_H
@@ -0,0 +1,415 @@
+#include "waveformlod.h"
+#include "waveformstore.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// On-disk layout, native byte order: header, level table, envelope arrays
+struct LodHeader
+{
+    char magic[4];
+    quint32 version;
+    quint32 levelCount;
+    quint32 factor;
+    qint64 baseBucketMs;
+    qint64 firstMs;
+    qint64 lastMs;
+    qint64 indexBytes; // Size of the segment's time index when this was built
+};
+
+struct LodLevel
+{
+    qint64 firstBucket;
+    quint32 count;
+    quint32 offset;
+};
+
+static_assert(sizeof(LodHeader) == 48, "unexpected lod header padding");
+static_assert(sizeof(LodLevel) == 16, "unexpected lod level padding");
+static_assert(sizeof(WaveformLod::Envelope) == 2, "unexpected envelope padding");
+
+constexpr char LodMagic[4] = {'S', 'M', 'W', 'L'};
+constexpr quint32 LodVersion = 1;
+
+// Used until a channel's first pair of blocks gives the real interval
+constexpr double DefaultSampleIntervalMs = 4.0;
+// A block that starts this many intervals late follows a recording gap
+constexpr double MaxGapFactor = 4.0;
+
+inline void merge(WaveformLod::Envelope &into, quint8 min, quint8 max)
+{
+    into.min = qMin(into.min, min);
+    into.max = qMax(into.max, max);
+}
+
+qint64 indexBytes(const QString &segmentPath)
+{
+    return QFileInfo(WaveformStore::indexPath(segmentPath)).size();
+}
+
+// Blocks only carry the time of their first sample; the samples of a block
+// are spread evenly up to the start of the next one. Sink is called as
+// sink(double timeMs, quint8 sample), oldest sample first.
+template <typename Sink>
+class SampleClock
+{
+public:
+    explicit SampleClock(Sink &sink) : m_sink(sink) {}
+
+    void push(qint64 timestampMs, const quint8 *samples, int count)
+    {
+        if (!m_pending.empty()) {
+            const double interval = double(timestampMs - m_timestampMs) / double(m_pending.size());
+            if (interval > 0 && (m_interval <= 0 || interval <= m_interval * MaxGapFactor))
+                m_interval = interval;
+            emitPending();
+        }
+        m_timestampMs = timestampMs;
+        m_pending.assign(samples, samples + count);
+    }
+
+    void finish()
+    {
+        emitPending();
+        m_pending.clear();
+    }
+
+private:
+    void emitPending()
+    {
+        const double interval = m_interval > 0 ? m_interval : DefaultSampleIntervalMs;
+        for (size_t i = 0; i < m_pending.size(); ++i)
+            m_sink(double(m_timestampMs) + double(i) * interval, m_pending[i]);
+    }
+
+    Sink &m_sink;
+    qint64 m_timestampMs = 0;
+    double m_interval = 0;
+    std::vector<quint8> m_pending;
+};
+
+// Starts empty, or from the level 0 of an existing pyramid that is extended
+struct Level0Builder
+{
+    std::vector<WaveformLod::Envelope> buckets;
+    qint64 firstBucket = 0;
+    qint64 firstMs = 0;
+    qint64 lastMs = 0;
+
+    void operator()(double ms, quint8 sample)
+    {
+        const qint64 bucket = qint64(std::floor(ms / WaveformLod::BaseBucketMs));
+        if (buckets.empty()) {
+            firstBucket = bucket;
+            firstMs = qint64(ms);
+        }
+
+        // Wall-clock steps backwards are dropped rather than reordered
+        if (bucket < firstBucket)
+            return;
+        const size_t index = size_t(bucket - firstBucket);
+        if (index >= buckets.size())
+            buckets.resize(index + 1, WaveformLod::EmptyEnvelope);
+
+        merge(buckets[index], sample, sample);
+        lastMs = qMax(lastMs, qint64(ms));
+    }
+};
+
+struct ColumnReducer
+{
+    qint64 fromMs;
+    double columnMs;
+    int columns;
+    WaveformLod::Envelope *out;
+
+    void operator()(double ms, quint8 sample)
+    {
+        if (ms < fromMs)
+            return;
+        const int column = int((ms - fromMs) / columnMs);
+        if (column < columns)
+            merge(out[column], sample, sample);
+    }
+};
+}
+
+struct WaveformLod::Segment
+{
+    QString path;
+    QFile file;
+    const uchar *data = nullptr;
+    LodHeader header;
+    LodLevel levels[LevelCount];
+
+    // Maps a .lod file; fails if it is missing or from another format.
+    // isCurrent() tells whether it still covers the whole segment.
+    bool open(const QString &segmentPath)
+    {
+        path = segmentPath;
+        file.setFileName(lodPath(segmentPath));
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+
+        const qint64 size = file.size();
+        const qint64 tableEnd = qint64(sizeof(LodHeader) + sizeof(levels));
+        if (size < tableEnd || !(data = file.map(0, size)))
+            return false;
+
+        memcpy(&header, data, sizeof(header));
+        memcpy(levels, data + sizeof(header), sizeof(levels));
+        if (memcmp(header.magic, LodMagic, sizeof(LodMagic)) != 0 || header.version != LodVersion
+            || header.levelCount != LevelCount || header.factor != Factor
+            || header.baseBucketMs != BaseBucketMs)
+            return false;
+
+        for (const LodLevel &level : levels) {
+            if (level.offset < tableEnd || level.offset + qint64(level.count) * 2 > size)
+                return false;
+        }
+        return true;
+    }
+
+    bool isCurrent() const
+    {
+        return header.indexBytes == indexBytes(path);
+    }
+
+    const Envelope *level(int index) const
+    {
+        return reinterpret_cast<const Envelope *>(data + levels[index].offset);
+    }
+};
+
+WaveformLod::WaveformLod(const QString &rootPath, const QString &patientId, int channel)
+    : m_rootPath(rootPath), m_patientId(patientId), m_channel(channel)
+{
+}
+
+WaveformLod::~WaveformLod() = default;
+
+qint64 WaveformLod::bucketMs(int level)
+{
+    qint64 ms = BaseBucketMs;
+    for (int i = 0; i < level; ++i)
+        ms *= Factor;
+    return ms;
+}
+
+QString WaveformLod::lodPath(const QString &segmentPath)
+{
+    const QFileInfo info(segmentPath);
+    return info.path() + QLatin1Char('/') + info.completeBaseName() + QStringLiteral(".lod");
+}
+
+bool WaveformLod::refresh(const WaveformLod *previous)
+{
+    m_segments.clear();
+
+    const QString dir = WaveformStore::channelPath(m_rootPath, m_patientId, m_channel);
+    for (const QString &name : WaveformStore::segmentFiles(m_rootPath, m_patientId, m_channel)) {
+        const QString segmentPath = dir + QLatin1Char('/') + name;
+
+        std::shared_ptr<Segment> segment = previous ? previous->findSegment(segmentPath) : nullptr;
+        if (!segment) {
+            segment = std::make_shared<Segment>();
+            if (!segment->open(segmentPath))
+                segment.reset();
+        }
+        if (segment && segment->isCurrent()) {
+            m_segments.push_back(std::move(segment));
+            continue;
+        }
+
+        // Missing, or the segment has grown since: only the live one grows,
+        // and only its new tail is read
+        const bool written = segment && segment->header.indexBytes < indexBytes(segmentPath)
+                                 ? extend(segmentPath, *segment)
+                                 : build(segmentPath);
+        auto fresh = std::make_shared<Segment>();
+        if (written && fresh->open(segmentPath))
+            m_segments.push_back(std::move(fresh));
+    }
+
+    return !m_segments.empty();
+}
+
+std::shared_ptr<WaveformLod::Segment> WaveformLod::findSegment(const QString &segmentPath) const
+{
+    for (const std::shared_ptr<Segment> &segment : m_segments) {
+        if (segment->path == segmentPath)
+            return segment;
+    }
+    return nullptr;
+}
+
+qint64 WaveformLod::firstMs() const
+{
+    return m_segments.empty() ? 0 : m_segments.front()->header.firstMs;
+}
+
+qint64 WaveformLod::lastMs() const
+{
+    return m_segments.empty() ? 0 : m_segments.back()->header.lastMs;
+}
+
+namespace {
+// Streams the blocks of a segment from the one containing fromMs on into level0
+bool readLevel0(const QString &segmentPath, qint64 fromMs, Level0Builder &level0)
+{
+    SampleClock<Level0Builder> clock(level0);
+    const bool readable = WaveformStore::readSegment(
+        segmentPath, fromMs, std::numeric_limits<qint64>::max(),
+        [&clock](qint64 timestampMs, const quint8 *samples, int count) {
+            clock.push(timestampMs, samples, count);
+        });
+    clock.finish();
+    return readable && !level0.buckets.empty();
+}
+
+// Derives the upper levels from level0 and replaces the .lod file of a segment
+bool writePyramid(const QString &segmentPath, const Level0Builder &level0, qint64 sourceIndexBytes)
+{
+    using Envelope = WaveformLod::Envelope;
+    constexpr int LevelCount = WaveformLod::LevelCount;
+    constexpr int Factor = WaveformLod::Factor;
+
+    std::vector<Envelope> levels[LevelCount];
+    LodLevel table[LevelCount];
+    levels[0] = level0.buckets;
+    table[0].firstBucket = level0.firstBucket;
+
+    // Each level merges Factor neighbouring buckets of the one below
+    for (int l = 1; l < LevelCount; ++l) {
+        const qint64 below = table[l - 1].firstBucket;
+        const qint64 first = below / Factor;
+        const qint64 last = (below + qint64(levels[l - 1].size()) - 1) / Factor;
+        levels[l].assign(size_t(last - first + 1), WaveformLod::EmptyEnvelope);
+        table[l].firstBucket = first;
+
+        for (size_t i = 0; i < levels[l - 1].size(); ++i) {
+            const Envelope &e = levels[l - 1][i];
+            if (!e.isEmpty())
+                merge(levels[l][size_t((below + qint64(i)) / Factor - first)], e.min, e.max);
+        }
+    }
+
+    quint32 offset = quint32(sizeof(LodHeader) + sizeof(table));
+    for (int l = 0; l < LevelCount; ++l) {
+        table[l].count = quint32(levels[l].size());
+        table[l].offset = offset;
+        offset += table[l].count * quint32(sizeof(Envelope));
+    }
+
+    LodHeader header = {};
+    memcpy(header.magic, LodMagic, sizeof(header.magic));
+    header.version = LodVersion;
+    header.levelCount = LevelCount;
+    header.factor = Factor;
+    header.baseBucketMs = WaveformLod::BaseBucketMs;
+    header.firstMs = level0.firstMs;
+    header.lastMs = level0.lastMs;
+    header.indexBytes = sourceIndexBytes;
+
+    // Replaced atomically; readers keep their mapping of the previous file
+    QSaveFile file(WaveformLod::lodPath(segmentPath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write waveform pyramid:" << file.errorString();
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(table), sizeof(table));
+    for (const std::vector<Envelope> &level : levels)
+        file.write(reinterpret_cast<const char *>(level.data()), qint64(level.size() * sizeof(Envelope)));
+
+    if (!file.commit()) {
+        qWarning() << "Could not write waveform pyramid:" << file.errorString();
+        return false;
+    }
+    return true;
+}
+}
+
+bool WaveformLod::build(const QString &segmentPath)
+{
+    // Read before the segment so a block written meanwhile only makes the result stale
+    const qint64 sourceIndexBytes = indexBytes(segmentPath);
+
+    Level0Builder level0;
+    if (!readLevel0(segmentPath, std::numeric_limits<qint64>::min(), level0))
+        return false;
+    return writePyramid(segmentPath, level0, sourceIndexBytes);
+}
+
+bool WaveformLod::extend(const QString &segmentPath, const Segment &stale)
+{
+    const qint64 sourceIndexBytes = indexBytes(segmentPath);
+
+    // The block the stale pyramid ended in is read again; merging its
+    // samples a second time leaves the min/max buckets unchanged
+    Level0Builder level0;
+    const LodLevel &base = stale.levels[0];
+    level0.buckets.assign(stale.level(0), stale.level(0) + base.count);
+    level0.firstBucket = base.firstBucket;
+    level0.firstMs = stale.header.firstMs;
+    level0.lastMs = stale.header.lastMs;
+    if (!readLevel0(segmentPath, stale.header.lastMs, level0))
+        return false;
+    return writePyramid(segmentPath, level0, sourceIndexBytes);
+}
+
+void WaveformLod::envelope(qint64 fromMs, qint64 toMs, int columns, Envelope *out) const
+{
+    std::fill(out, out + qMax(columns, 0), EmptyEnvelope);
+    if (columns <= 0 || toMs <= fromMs)
+        return;
+
+    // Coarsest level that still has a bucket per column
+    const double columnMs = double(toMs - fromMs) / columns;
+    int level = -1;
+    while (level + 1 < LevelCount && bucketMs(level + 1) <= columnMs)
+        ++level;
+
+    if (level < 0) {
+        rawEnvelope(fromMs, toMs, columns, out);
+        return;
+    }
+
+    const qint64 width = bucketMs(level);
+    for (const std::shared_ptr<Segment> &segment : m_segments) {
+        if (segment->header.lastMs < fromMs || segment->header.firstMs >= toMs)
+            continue;
+
+        const LodLevel &info = segment->levels[level];
+        const Envelope *buckets = segment->level(level);
+        const qint64 first = qMax(info.firstBucket, fromMs / width);
+        const qint64 end = qMin(info.firstBucket + qint64(info.count), (toMs + width - 1) / width);
+
+        // A bucket goes to the column that contains its start
+        for (qint64 b = first; b < end; ++b) {
+            const Envelope &e = buckets[b - info.firstBucket];
+            if (e.isEmpty())
+                continue;
+            const int column = qBound(0, int(double(b * width - fromMs) / columnMs), columns - 1);
+            merge(out[column], e.min, e.max);
+        }
+    }
+}
+
+void WaveformLod::rawEnvelope(qint64 fromMs, qint64 toMs, int columns, Envelope *out) const
+{
+    ColumnReducer reducer{fromMs, double(toMs - fromMs) / columns, columns, out};
+    SampleClock<ColumnReducer> clock(reducer);
+
+    WaveformStore::read(m_rootPath, m_patientId, m_channel, fromMs, toMs,
+                        [&clock](qint64 timestampMs, const quint8 *samples, int count) {
+                            clock.push(timestampMs, samples, count);
+                        });
+    clock.finish();
+}
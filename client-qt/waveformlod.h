@@ -0,0 +1,77 @@
+#ifndef WAVEFORMLOD_H
+#define WAVEFORMLOD_H
+
+#include <QFile>
+#include <QString>
+#include <memory>
+#include <vector>
+
+// Min/max level-of-detail pyramid over one channel of the waveform store.
+//
+// Every segment gets a .lod file next to it holding LevelCount levels of
+// min/max envelopes over fixed wall-clock buckets: BaseBucketMs at level 0,
+// Factor times wider at each level above. Buckets are aligned to the epoch,
+// so the same bucket index means the same time span in every segment. The
+// files are built once by streaming the segment block by block and
+// memory-mapped for queries. When a segment has grown since, only the blocks
+// from its previous end on are read and merged into the existing pyramid.
+//
+// envelope() reduces a time range to one min/max pair per output column by
+// reading the coarsest level that still has at least one bucket per column,
+// so its cost depends on the number of columns, not on the zoom. Ranges
+// narrower than one level-0 bucket per column are reduced from the raw
+// samples, of which only those in range are decoded.
+class WaveformLod
+{
+public:
+    struct Envelope
+    {
+        quint8 min;
+        quint8 max;
+
+        bool isEmpty() const { return min > max; }
+    };
+
+    static constexpr Envelope EmptyEnvelope = {0xFF, 0x00};
+    static constexpr int LevelCount = 8;
+    static constexpr int Factor = 4;
+    static constexpr qint64 BaseBucketMs = 40;
+
+    WaveformLod(const QString &rootPath, const QString &patientId, int channel);
+    ~WaveformLod();
+
+    // Builds missing or stale pyramids and maps them; returns false if the
+    // channel has no recorded data. Mappings of previous (an earlier load of
+    // the same channel) are shared for segments that have not grown since.
+    // previous is only read, so it may still be queried meanwhile.
+    bool refresh(const WaveformLod *previous = nullptr);
+
+    bool isEmpty() const { return m_segments.empty(); }
+    qint64 firstMs() const;
+    qint64 lastMs() const;
+
+    // Fills columns envelopes for [fromMs, toMs); empty where nothing is recorded
+    void envelope(qint64 fromMs, qint64 toMs, int columns, Envelope *out) const;
+
+    static qint64 bucketMs(int level);
+
+    // Writes the .lod file of a segment; exposed for tools and benchmarks
+    static bool build(const QString &segmentPath);
+    static QString lodPath(const QString &segmentPath);
+
+private:
+    struct Segment;
+
+    // Rewrites the .lod file of a segment that has grown since stale was built
+    static bool extend(const QString &segmentPath, const Segment &stale);
+    std::shared_ptr<Segment> findSegment(const QString &segmentPath) const;
+
+    void rawEnvelope(qint64 fromMs, qint64 toMs, int columns, Envelope *out) const;
+
+    QString m_rootPath;
+    QString m_patientId;
+    int m_channel;
+    std::vector<std::shared_ptr<Segment>> m_segments; // Shared with later loads, never modified
+};
+
+#endif // WAVEFORMLOD_H
@@ -0,0 +1,271 @@
+#include "waveformreview.h"
+#include "waveformstore.h"
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <QThreadPool>
+#include <QSGGeometryNode>
+#include <QSGFlatColorMaterial>
+
+WaveformReviewItem::WaveformReviewItem(QQuickItem *parent) : QQuickItem(parent)
+{
+    setFlag(ItemHasContents, true);
+}
+
+void WaveformReviewItem::setPatientId(const QString &patientId)
+{
+    if (m_patientId == patientId)
+        return;
+    m_patientId = patientId;
+    reload();
+    emit patientIdChanged();
+}
+
+void WaveformReviewItem::setChannel(int channel)
+{
+    channel = qBound(0, channel, int(WaveformStore::ChannelCount) - 1);
+    if (m_channel == channel)
+        return;
+    m_channel = channel;
+    reload();
+    emit channelChanged();
+}
+
+void WaveformReviewItem::setViewStartMs(qint64 ms)
+{
+    if (m_viewStartMs == ms)
+        return;
+    m_viewStartMs = ms;
+    requestEnvelopes();
+    emit viewChanged();
+}
+
+void WaveformReviewItem::setViewSpanMs(qint64 ms)
+{
+    ms = qMax<qint64>(1, ms);
+    if (m_viewSpanMs == ms)
+        return;
+    m_viewSpanMs = ms;
+    requestEnvelopes();
+    emit viewChanged();
+}
+
+void WaveformReviewItem::setColor(const QColor &color)
+{
+    if (m_color == color)
+        return;
+    m_color = color;
+    m_materialDirty = true;
+    update();
+    emit colorChanged();
+}
+
+void WaveformReviewItem::setMaximumValue(int value)
+{
+    value = qMax(1, value);
+    if (m_maximumValue == value)
+        return;
+    m_maximumValue = value;
+    requestRepaint();
+    emit maximumValueChanged();
+}
+
+void WaveformReviewItem::reload()
+{
+    startLoad(false);
+}
+
+void WaveformReviewItem::refresh()
+{
+    // A load in progress picks the new samples up anyway
+    if (!m_loading && !m_refreshing)
+        startLoad(true);
+}
+
+void WaveformReviewItem::startLoad(bool background)
+{
+    const quint64 generation = ++m_generation;
+
+    if (m_patientId.isEmpty()) {
+        finishReload(nullptr, generation, false);
+        return;
+    }
+
+    if (background) {
+        m_refreshing = true;
+    } else if (!m_loading) {
+        m_loading = true;
+        emit loadingChanged();
+    }
+
+    // Building pyramids streams whole segments, keep it off the GUI thread.
+    // A background refresh reuses the current pyramids; they stay in use for
+    // drawing meanwhile, which is safe since refresh() only reads them.
+    auto lod = std::make_shared<WaveformLod>(WaveformStore::defaultRootPath(), m_patientId, m_channel);
+    std::shared_ptr<WaveformLod> previous = background ? m_lod : nullptr;
+    QPointer<WaveformReviewItem> self(this);
+    QThreadPool::globalInstance()->start([self, lod, previous, generation, background]() {
+        lod->refresh(previous.get());
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, lod, generation, background]() {
+            if (self)
+                self->finishReload(lod, generation, background);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void WaveformReviewItem::finishReload(std::shared_ptr<WaveformLod> lod, quint64 generation, bool background)
+{
+    if (background)
+        m_refreshing = false;
+    if (generation != m_generation)
+        return;
+
+    if (lod && lod->isEmpty())
+        lod.reset();
+
+    // Nothing recorded since the last load
+    const bool unchanged = background && (lod ? m_lod && lod->firstMs() == m_lod->firstMs()
+                                                    && lod->lastMs() == m_lod->lastMs()
+                                              : !m_lod);
+    if (unchanged)
+        return;
+
+    m_lod = std::move(lod);
+    requestEnvelopes();
+    emit recordedRangeChanged();
+    if (m_loading) {
+        m_loading = false;
+        emit loadingChanged();
+    }
+}
+
+void WaveformReviewItem::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+        requestEnvelopes();
+}
+
+void WaveformReviewItem::requestEnvelopes()
+{
+    if (m_envelopesRunning) {
+        m_envelopesQueued = true;
+        return;
+    }
+
+    const int columns = qMax(2, int(width()));
+    if (!m_lod) {
+        m_envelopes.fill(WaveformLod::EmptyEnvelope, columns);
+        requestRepaint();
+        return;
+    }
+
+    // Reads the pyramids, or raw samples from the segment files when zoomed
+    // in, so it stays off the GUI and render threads
+    m_envelopesRunning = true;
+    std::shared_ptr<WaveformLod> lod = m_lod;
+    const qint64 fromMs = m_viewStartMs;
+    const qint64 toMs = m_viewStartMs + m_viewSpanMs;
+    QPointer<WaveformReviewItem> self(this);
+    QThreadPool::globalInstance()->start([self, lod, fromMs, toMs, columns]() {
+        QVector<WaveformLod::Envelope> envelopes(columns);
+        lod->envelope(fromMs, toMs, columns, envelopes.data());
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, envelopes]() {
+            if (self)
+                self->finishEnvelopes(envelopes);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void WaveformReviewItem::finishEnvelopes(const QVector<WaveformLod::Envelope> &envelopes)
+{
+    m_envelopesRunning = false;
+    m_envelopes = envelopes;
+    requestRepaint();
+
+    if (m_envelopesQueued) {
+        m_envelopesQueued = false;
+        requestEnvelopes();
+    }
+}
+
+void WaveformReviewItem::requestRepaint()
+{
+    m_dirty = true;
+    update();
+}
+
+QSGNode *WaveformReviewItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    auto *node = static_cast<QSGGeometryNode *>(oldNode);
+    const int columns = qMax(2, int(m_envelopes.size()));
+
+    // One vertical min/max segment per pixel column
+    if (!node) {
+        node = new QSGGeometryNode;
+        auto *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), columns * 2);
+        geometry->setDrawingMode(QSGGeometry::DrawLines);
+        geometry->setLineWidth(1);
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
+        node->setMaterial(new QSGFlatColorMaterial);
+        node->setFlag(QSGNode::OwnsMaterial);
+        m_dirty = true;
+        m_materialDirty = true;
+    }
+
+    QSGGeometry *geometry = node->geometry();
+    if (geometry->vertexCount() != columns * 2) {
+        geometry->allocate(columns * 2);
+        m_dirty = true;
+    }
+
+    if (m_materialDirty) {
+        static_cast<QSGFlatColorMaterial *>(node->material())->setColor(m_color);
+        node->markDirty(QSGNode::DirtyMaterial);
+        m_materialDirty = false;
+    }
+
+    if (!m_dirty)
+        return node;
+
+    QSGGeometry::Point2D *vertices = geometry->vertexDataAsPoint2D();
+    const float h = float(height());
+    const float xStep = float(width()) / float(columns);
+    const float yScale = h / float(m_maximumValue);
+    WaveformLod::Envelope previous = WaveformLod::EmptyEnvelope;
+
+    for (int column = 0; column < columns; ++column) {
+        const float x = (column + 0.5f) * xStep;
+        WaveformLod::Envelope e = column < m_envelopes.size() ? m_envelopes[column] : WaveformLod::EmptyEnvelope;
+
+        if (e.isEmpty()) {
+            // Nothing recorded here; a zero-length segment draws nothing
+            vertices[2 * column].set(x, h);
+            vertices[2 * column + 1].set(x, h);
+            previous = e;
+            continue;
+        }
+
+        // Stretch each column to touch its neighbour so the trace stays connected
+        const WaveformLod::Envelope drawn = e;
+        if (!previous.isEmpty()) {
+            e.min = qMin(e.min, previous.max);
+            e.max = qMax(e.max, previous.min);
+        }
+        previous = drawn;
+
+        float top = h - e.max * yScale;
+        float bottom = h - e.min * yScale;
+        if (bottom - top < 1.0f) {
+            top -= 0.5f;
+            bottom += 0.5f;
+        }
+        vertices[2 * column].set(x, bottom);
+        vertices[2 * column + 1].set(x, top);
+    }
+
+    m_dirty = false;
+    node->markDirty(QSGNode::DirtyGeometry);
+    return node;
+}
@@ -0,0 +1,111 @@
+#ifndef WAVEFORMREVIEW_H
+#define WAVEFORMREVIEW_H
+
+#include <QQuickItem>
+#include <QColor>
+#include <QVector>
+#include <memory>
+#include "waveformlod.h"
+
+// Full-disclosure review of one stored waveform channel.
+// The visible window [viewStartMs, viewStartMs + viewSpanMs) is drawn as
+// one min/max column per pixel taken from the channel's WaveformLod, so
+// panning or zooming costs the same whether the window covers seconds or a
+// whole day. Pyramids are built on the global thread pool by reload(); the
+// item draws nothing until the first load has finished. refresh() picks up
+// newly recorded samples the same way without showing the item as loading.
+// The column envelopes are computed on the pool as well (zoomed in, that
+// means decoding raw samples from the segment files); the scene graph only
+// turns the latest result into vertices.
+class WaveformReviewItem : public QQuickItem
+{
+    Q_OBJECT
+    QML_NAMED_ELEMENT(WaveformReview)
+
+    Q_PROPERTY(QString patientId READ patientId WRITE setPatientId NOTIFY patientIdChanged)
+    Q_PROPERTY(int channel READ channel WRITE setChannel NOTIFY channelChanged)
+    Q_PROPERTY(qint64 viewStartMs READ viewStartMs WRITE setViewStartMs NOTIFY viewChanged)
+    Q_PROPERTY(qint64 viewSpanMs READ viewSpanMs WRITE setViewSpanMs NOTIFY viewChanged)
+    Q_PROPERTY(qint64 recordedStartMs READ recordedStartMs NOTIFY recordedRangeChanged)
+    Q_PROPERTY(qint64 recordedEndMs READ recordedEndMs NOTIFY recordedRangeChanged)
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
+    Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
+    Q_PROPERTY(int maximumValue READ maximumValue WRITE setMaximumValue NOTIFY maximumValueChanged)
+
+public:
+    explicit WaveformReviewItem(QQuickItem *parent = nullptr);
+
+    QString patientId() const { return m_patientId; }
+    void setPatientId(const QString &patientId);
+
+    int channel() const { return m_channel; }
+    void setChannel(int channel);
+
+    qint64 viewStartMs() const { return m_viewStartMs; }
+    void setViewStartMs(qint64 ms);
+
+    qint64 viewSpanMs() const { return m_viewSpanMs; }
+    void setViewSpanMs(qint64 ms);
+
+    qint64 recordedStartMs() const { return m_lod ? m_lod->firstMs() : 0; }
+    qint64 recordedEndMs() const { return m_lod ? m_lod->lastMs() : 0; }
+    bool loading() const { return m_loading; }
+
+    QColor color() const { return m_color; }
+    void setColor(const QColor &color);
+
+    int maximumValue() const { return m_maximumValue; }
+    void setMaximumValue(int value);
+
+    // Loads the channel again from scratch, e.g. after a patient change
+    Q_INVOKABLE void reload();
+
+    // Background update for new recordings: only segments that have grown
+    // are read, and only their new blocks
+    Q_INVOKABLE void refresh();
+
+signals:
+
+    void patientIdChanged();
+    void channelChanged();
+    void viewChanged();
+    void recordedRangeChanged();
+    void loadingChanged();
+    void colorChanged();
+    void maximumValueChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+private:
+    void startLoad(bool background);
+    void finishReload(std::shared_ptr<WaveformLod> lod, quint64 generation, bool background);
+    void requestEnvelopes();
+    void finishEnvelopes(const QVector<WaveformLod::Envelope> &envelopes);
+    void requestRepaint();
+
+    QString m_patientId;
+    int m_channel = 0;
+    qint64 m_viewStartMs = 0;
+    qint64 m_viewSpanMs = 10000;
+    QColor m_color = QColor("#4CAF50");
+    int m_maximumValue = 255;
+
+    std::shared_ptr<WaveformLod> m_lod;
+    quint64 m_generation = 0; // Only the newest reload() is applied
+    bool m_loading = false;
+    bool m_refreshing = false;
+
+    // Latest envelopes from the pool; one computation runs at a time and
+    // view changes meanwhile are folded into the next one
+    QVector<WaveformLod::Envelope> m_envelopes;
+    bool m_envelopesRunning = false;
+    bool m_envelopesQueued = false;
+
+    // Render state, only touched while the scene graph synchronises
+    bool m_dirty = true;
+    bool m_materialDirty = true;
+};
+
+#endif // WAVEFORMREVIEW_H
@@ -0,0 +1,328 @@
+#include "waveformstore.h"
+#include "waveformcodec.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QUrl>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// On-disk layout, native byte order
+struct SegmentHeader
+{
+    char magic[4];
+    quint32 version;
+    quint32 channel;
+    quint32 blockSamples;
+    qint64 startMs;
+    qint64 reserved;
+};
+
+struct BlockHeader
+{
+    quint32 magic;
+    quint16 count;
+    quint16 bytes;
+    qint64 timestampMs;
+};
+
+struct IndexEntry
+{
+    qint64 timestampMs;
+    quint32 offset;
+    quint32 count;
+};
+
+static_assert(sizeof(SegmentHeader) == 32, "unexpected segment header padding");
+static_assert(sizeof(BlockHeader) == 16, "unexpected block header padding");
+static_assert(sizeof(IndexEntry) == 16, "unexpected index entry padding");
+
+constexpr char SegmentMagic[4] = {'S', 'M', 'W', 'F'};
+constexpr quint32 FormatVersion = 1;
+constexpr quint32 BlockMagic = 0x4B4C4257; // "WBLK"
+
+bool blockAt(const uchar *data, qint64 size, qint64 offset, BlockHeader &header)
+{
+    if (offset + qint64(sizeof(BlockHeader)) > size)
+        return false;
+    memcpy(&header, data + offset, sizeof(BlockHeader));
+    return header.magic == BlockMagic
+           && offset + qint64(sizeof(BlockHeader)) + header.bytes <= size;
+}
+
+// Offset of the last block starting at or before fromMs, from the time
+// index when it is usable, otherwise by walking the block headers
+qint64 findStartOffset(const QString &indexPath, const uchar *data, qint64 size, qint64 fromMs)
+{
+    qint64 start = sizeof(SegmentHeader);
+
+    QFile index(indexPath);
+    if (index.open(QIODevice::ReadOnly) && index.size() >= qint64(sizeof(IndexEntry))) {
+        const qint64 entries = index.size() / qint64(sizeof(IndexEntry));
+        if (const uchar *map = index.map(0, entries * qint64(sizeof(IndexEntry)))) {
+            const auto *first = reinterpret_cast<const IndexEntry *>(map);
+            const auto *last = first + entries;
+            const auto *it = std::upper_bound(first, last, fromMs, [](qint64 ms, const IndexEntry &entry) {
+                return ms < entry.timestampMs;
+            });
+            if (it != first)
+                start = qMin(qint64((it - 1)->offset), size);
+            index.unmap(const_cast<uchar *>(map));
+
+            BlockHeader header;
+            if (blockAt(data, size, start, header))
+                return start;
+            start = sizeof(SegmentHeader);
+        }
+    }
+
+    qint64 offset = start;
+    BlockHeader header;
+    while (blockAt(data, size, offset, header) && header.timestampMs <= fromMs) {
+        start = offset;
+        offset += sizeof(BlockHeader) + header.bytes;
+    }
+    return start;
+}
+}
+
+WaveformStore::WaveformStore(const QString &rootPath) : m_rootPath(rootPath)
+{
+}
+
+WaveformStore::~WaveformStore()
+{
+    close();
+}
+
+QString WaveformStore::channelName(int channel)
+{
+    static const char *const names[ChannelCount] = {
+        "ecg_i", "ecg_ii", "ecg_iii", "ecg_v", "ecg_avr", "ecg_avf", "ecg_avl", "pleth", "resp"
+    };
+    return (channel >= 0 && channel < ChannelCount) ? QString::fromLatin1(names[channel]) : QString();
+}
+
+QString WaveformStore::channelPath(const QString &rootPath, const QString &patientId, int channel)
+{
+    // Patient ids are free text, percent-encoding keeps them unique and path-safe.
+    // '.' is encoded too, so ids such as "." or ".." cannot name the root or
+    // its parent.
+    const QString patientDir = QString::fromLatin1(QUrl::toPercentEncoding(patientId, QByteArray(), "."));
+    return rootPath + QLatin1Char('/') + patientDir + QLatin1Char('/') + channelName(channel);
+}
+
+QStringList WaveformStore::segmentFiles(const QString &rootPath, const QString &patientId, int channel)
+{
+    // Names are zero-padded start times, so name order is time order
+    return QDir(channelPath(rootPath, patientId, channel))
+        .entryList({QStringLiteral("*.wfs")}, QDir::Files, QDir::Name);
+}
+
+void WaveformStore::setPatient(const QString &patientId)
+{
+    if (m_patientId == patientId)
+        return;
+
+    close();
+    m_patientId = patientId;
+}
+
+void WaveformStore::append(Channel channel, const quint8 *samples, int count)
+{
+    if (m_patientId.isEmpty())
+        return;
+
+    ChannelState &state = m_channels[channel];
+    while (count > 0) {
+        if (state.stagedCount == 0)
+            state.stagedMs = QDateTime::currentMSecsSinceEpoch();
+
+        const int n = qMin(count, BlockSamples - state.stagedCount);
+        memcpy(state.staged + state.stagedCount, samples, n);
+        state.stagedCount += n;
+        samples += n;
+        count -= n;
+
+        if (state.stagedCount == BlockSamples)
+            writeBlock(channel);
+    }
+}
+
+void WaveformStore::close()
+{
+    for (int channel = 0; channel < ChannelCount; ++channel) {
+        if (m_channels[channel].stagedCount > 0)
+            writeBlock(channel);
+        closeSegment(channel);
+    }
+}
+
+void WaveformStore::writeBlock(int channel)
+{
+    ChannelState &state = m_channels[channel];
+    const int count = state.stagedCount;
+    state.stagedCount = 0;
+
+    const qint64 needed = sizeof(BlockHeader) + WaveformCodec::maxEncodedSize(count);
+    if (state.segment && state.segment->used + needed > SegmentSize)
+        closeSegment(channel);
+    if (!state.segment && !openSegment(channel, state.stagedMs))
+        return;
+
+    Segment &segment = *state.segment;
+    uchar *block = segment.data + segment.used;
+    const int bytes = WaveformCodec::encode(state.staged, count, block + sizeof(BlockHeader));
+
+    // Header last, so a block is only recognised once its payload is complete
+    const BlockHeader header{BlockMagic, quint16(count), quint16(bytes), state.stagedMs};
+    memcpy(block, &header, sizeof(header));
+
+    const IndexEntry entry{state.stagedMs, quint32(segment.used), quint32(count)};
+    if (segment.index.write(reinterpret_cast<const char *>(&entry), sizeof(entry)) != qint64(sizeof(entry)))
+        qWarning() << "Waveform index write failed:" << segment.index.errorString();
+
+    segment.used += sizeof(BlockHeader) + bytes;
+}
+
+bool WaveformStore::openSegment(int channel, qint64 startMs)
+{
+    const QString dir = channelPath(m_rootPath, m_patientId, channel);
+    if (!QDir().mkpath(dir)) {
+        qWarning() << "Could not create waveform directory:" << dir;
+        return false;
+    }
+
+    // The name must be new: another writer (a bed recording the same
+    // patient) or an earlier segment may already use this millisecond, so
+    // later ones are tried. Only files created here are removed on failure.
+    auto segment = std::make_unique<Segment>();
+    bool created = false;
+    for (qint64 nameMs = startMs; nameMs < startMs + MaxNameAttempts && !created; ++nameMs) {
+        const QString base = dir + QLatin1Char('/') + QStringLiteral("%1").arg(nameMs, 13, 10, QLatin1Char('0'));
+        segment->file.setFileName(base + QStringLiteral(".wfs"));
+        segment->index.setFileName(base + QStringLiteral(".idx"));
+
+        if (!segment->file.open(QIODevice::ReadWrite | QIODevice::NewOnly)) {
+            if (segment->file.exists())
+                continue;
+            break;
+        }
+        if (!segment->index.open(QIODevice::WriteOnly | QIODevice::NewOnly | QIODevice::Unbuffered)) {
+            const bool taken = segment->index.exists();
+            segment->file.close();
+            segment->file.remove();
+            if (taken)
+                continue;
+            break;
+        }
+        created = true;
+    }
+
+    if (!created) {
+        qWarning() << "Could not create waveform segment" << segment->file.fileName() << ":"
+                   << segment->file.errorString() << segment->index.errorString();
+        return false;
+    }
+
+    if (!segment->file.resize(SegmentSize) || !(segment->data = segment->file.map(0, SegmentSize))) {
+        qWarning() << "Could not map waveform segment" << segment->file.fileName() << ":"
+                   << segment->file.errorString();
+        segment->file.close();
+        segment->index.close();
+        segment->file.remove();
+        segment->index.remove();
+        return false;
+    }
+
+    SegmentHeader header = {};
+    memcpy(header.magic, SegmentMagic, sizeof(header.magic));
+    header.version = FormatVersion;
+    header.channel = quint32(channel);
+    header.blockSamples = BlockSamples;
+    header.startMs = startMs;
+    memcpy(segment->data, &header, sizeof(header));
+    segment->used = sizeof(header);
+
+    m_channels[channel].segment = std::move(segment);
+    return true;
+}
+
+void WaveformStore::closeSegment(int channel)
+{
+    std::unique_ptr<Segment> segment = std::move(m_channels[channel].segment);
+    if (!segment)
+        return;
+
+    segment->file.unmap(segment->data);
+    segment->file.resize(segment->used);
+    segment->file.close();
+    segment->index.close();
+}
+
+qint64 WaveformStore::segmentStartMs(const QString &segmentPath)
+{
+    return QFileInfo(segmentPath).completeBaseName().toLongLong();
+}
+
+QString WaveformStore::indexPath(const QString &segmentPath)
+{
+    const QFileInfo info(segmentPath);
+    return info.path() + QLatin1Char('/') + info.completeBaseName() + QStringLiteral(".idx");
+}
+
+bool WaveformStore::read(const QString &rootPath, const QString &patientId, int channel,
+                         qint64 fromMs, qint64 toMs, const BlockVisitor &visitor)
+{
+    const QString dir = channelPath(rootPath, patientId, channel);
+    const QStringList segments = segmentFiles(rootPath, patientId, channel);
+    if (segments.isEmpty())
+        return false;
+
+    for (int i = 0; i < segments.size(); ++i) {
+        if (segmentStartMs(segments[i]) > toMs)
+            break;
+        // Segments of a channel do not overlap; skip those that end before fromMs
+        if (i + 1 < segments.size() && segmentStartMs(segments[i + 1]) <= fromMs)
+            continue;
+
+        readSegment(dir + QLatin1Char('/') + segments[i], fromMs, toMs, visitor);
+    }
+
+    return true;
+}
+
+bool WaveformStore::readSegment(const QString &segmentPath, qint64 fromMs, qint64 toMs, const BlockVisitor &visitor)
+{
+    QFile file(segmentPath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(SegmentHeader)))
+        return false;
+
+    const qint64 size = file.size();
+    const uchar *data = file.map(0, size);
+    if (!data || memcmp(data, SegmentMagic, sizeof(SegmentMagic)) != 0) {
+        qWarning() << "Skipping unreadable waveform segment:" << segmentPath;
+        return false;
+    }
+
+    qint64 offset = findStartOffset(indexPath(segmentPath), data, size, fromMs);
+
+    QVector<quint8> samples;
+    BlockHeader header;
+    while (blockAt(data, size, offset, header) && header.timestampMs <= toMs) {
+        samples.resize(header.count);
+        if (WaveformCodec::decode(data + offset + sizeof(BlockHeader), header.bytes,
+                                  samples.data(), header.count) < 0) {
+            qWarning() << "Corrupt waveform block in" << segmentPath << "at" << offset;
+            break;
+        }
+        visitor(header.timestampMs, samples.constData(), header.count);
+        offset += sizeof(BlockHeader) + header.bytes;
+    }
+
+    return true;
+}
@@ -0,0 +1,104 @@
+#ifndef WAVEFORMSTORE_H
+#define WAVEFORMSTORE_H
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <array>
+#include <functional>
+#include <memory>
+
+// Full-disclosure storage of the raw waveforms, one directory per patient
+// and channel: <root>/<patient>/<channel>/<startMs>.wfs (a few ms later
+// if that name is taken)
+//
+// A segment is a fixed-size memory-mapped file that is only ever appended
+// to. Samples are staged per channel and written as blocks of up to
+// BlockSamples delta/varint coded samples (see WaveformCodec), each block
+// stamped with the wall-clock time of its first sample. Every block also
+// gets an entry in the segment's .idx file, the time index readers use to
+// seek. A segment is truncated to its used size when it is closed; a segment
+// left behind by a crash keeps its zero tail, which readers skip.
+//
+// The writing side is not thread-safe and is used from the acquisition
+// thread only; read() opens its own mappings and may run on any thread.
+class WaveformStore
+{
+public:
+    enum Channel {
+        EcgI, EcgII, EcgIII, EcgV, EcgAVR, EcgAVF, EcgAVL,
+        Pleth,
+        Resp,
+        ChannelCount
+    };
+
+    static constexpr int BlockSamples = 256;
+    static constexpr qint64 SegmentSize = 4 * 1024 * 1024;
+    static constexpr int MaxNameAttempts = 64; // Segment names tried from startMs on
+
+    // Called once per decoded block with the time of its first sample
+    using BlockVisitor = std::function<void(qint64 timestampMs, const quint8 *samples, int count)>;
+
+    explicit WaveformStore(const QString &rootPath = defaultRootPath());
+    ~WaveformStore();
+
+    static QString defaultRootPath() { return QStringLiteral("waveforms"); }
+    static QString channelName(int channel);
+    QString rootPath() const { return m_rootPath; }
+
+    // Closes the open segments; new samples go to the given patient.
+    // An empty id stops recording.
+    void setPatient(const QString &patientId);
+    QString patientId() const { return m_patientId; }
+    bool isRecording() const { return !m_patientId.isEmpty(); }
+
+    void append(Channel channel, const quint8 *samples, int count);
+    void append(Channel channel, quint8 sample) { append(channel, &sample, 1); }
+
+    // Writes the staged samples and closes the open segments
+    void close();
+
+    // Visits the stored blocks of a channel that overlap [fromMs, toMs],
+    // oldest first. Returns false if nothing is stored for the channel.
+    static bool read(const QString &rootPath, const QString &patientId, int channel,
+                     qint64 fromMs, qint64 toMs, const BlockVisitor &visitor);
+
+    // Same for a single segment file
+    static bool readSegment(const QString &segmentPath, qint64 fromMs, qint64 toMs, const BlockVisitor &visitor);
+
+    // Files of one patient's channel, oldest segment first
+    static QString channelPath(const QString &rootPath, const QString &patientId, int channel);
+    static QStringList segmentFiles(const QString &rootPath, const QString &patientId, int channel);
+
+    // Start time encoded in a segment file name, and its time index file
+    static qint64 segmentStartMs(const QString &segmentPath);
+    static QString indexPath(const QString &segmentPath);
+
+private:
+    struct Segment
+    {
+        QFile file;
+        QFile index;
+        uchar *data = nullptr;
+        qint64 used = 0;
+    };
+
+    struct ChannelState
+    {
+        std::unique_ptr<Segment> segment;
+        quint8 staged[BlockSamples];
+        int stagedCount = 0;
+        qint64 stagedMs = 0;
+    };
+
+    bool openSegment(int channel, qint64 startMs);
+    void closeSegment(int channel);
+    void writeBlock(int channel);
+
+    QString m_rootPath;
+    QString m_patientId;
+    std::array<ChannelState, ChannelCount> m_channels;
+};
+
+#endif // WAVEFORMSTORE_H
@@ -0,0 +1,179 @@
+#include "waveformtrace.h"
+
+#include <QSGGeometryNode>
+#include <QSGFlatColorMaterial>
+
+WaveformTraceItem::WaveformTraceItem(QQuickItem *parent) : QQuickItem(parent)
+{
+    setFlag(ItemHasContents, true);
+}
+
+void WaveformTraceItem::setBuffer(WaveformBuffer *buffer)
+{
+    if (m_buffer == buffer)
+        return;
+
+    if (m_buffer)
+        disconnect(m_buffer, nullptr, this, nullptr);
+
+    m_buffer = buffer;
+    if (m_buffer) {
+        // update() is coalesced by the scene graph to one sync per frame
+        connect(m_buffer, &WaveformBuffer::samplesAppended, this, &QQuickItem::update);
+        connect(m_buffer, &WaveformBuffer::capacityChanged, this, &WaveformTraceItem::requestRebuild);
+    }
+
+    requestRebuild();
+    emit bufferChanged();
+}
+
+void WaveformTraceItem::setColor(const QColor &color)
+{
+    if (m_color == color)
+        return;
+    m_color = color;
+    m_materialDirty = true;
+    update();
+    emit colorChanged();
+}
+
+void WaveformTraceItem::setLineWidth(qreal width)
+{
+    if (qFuzzyCompare(m_lineWidth, width))
+        return;
+    m_lineWidth = width;
+    m_materialDirty = true;
+    update();
+    emit lineWidthChanged();
+}
+
+void WaveformTraceItem::setVisibleSamples(int samples)
+{
+    samples = qMax(2, samples);
+    if (m_visibleSamples == samples)
+        return;
+    m_visibleSamples = samples;
+    requestRebuild();
+    emit visibleSamplesChanged();
+}
+
+void WaveformTraceItem::setEraseSamples(int samples)
+{
+    samples = qMax(0, samples);
+    if (m_eraseSamples == samples)
+        return;
+    m_eraseSamples = samples;
+    requestRebuild();
+    emit eraseSamplesChanged();
+}
+
+void WaveformTraceItem::setMaximumValue(int value)
+{
+    value = qMax(1, value);
+    if (m_maximumValue == value)
+        return;
+    m_maximumValue = value;
+    requestRebuild();
+    emit maximumValueChanged();
+}
+
+void WaveformTraceItem::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+        requestRebuild();
+}
+
+void WaveformTraceItem::requestRebuild()
+{
+    m_rebuild = true;
+    update();
+}
+
+QSGNode *WaveformTraceItem::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *)
+{
+    auto *node = static_cast<QSGGeometryNode *>(oldNode);
+    const int points = m_visibleSamples;
+
+    // One line segment (two vertices) per sample slot across the sweep
+    if (!node) {
+        node = new QSGGeometryNode;
+        auto *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), points * 2);
+        geometry->setDrawingMode(QSGGeometry::DrawLines);
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
+        node->setMaterial(new QSGFlatColorMaterial);
+        node->setFlag(QSGNode::OwnsMaterial);
+        m_rebuild = true;
+        m_materialDirty = true;
+    }
+
+    QSGGeometry *geometry = node->geometry();
+    if (geometry->vertexCount() != points * 2) {
+        geometry->allocate(points * 2);
+        m_rebuild = true;
+    }
+
+    if (m_materialDirty) {
+        static_cast<QSGFlatColorMaterial *>(node->material())->setColor(m_color);
+        geometry->setLineWidth(float(m_lineWidth));
+        node->markDirty(QSGNode::DirtyMaterial);
+        m_materialDirty = false;
+    }
+
+    const qint64 cursor = m_buffer ? m_buffer->writeCursor() : 0;
+    if (cursor < m_renderedCursor)
+        m_rebuild = true; // Buffer was cleared
+
+    QSGGeometry::Point2D *vertices = geometry->vertexDataAsPoint2D();
+    const float h = float(height());
+    const float xStep = float(width()) / float(points - 1);
+    const float yScale = h / float(m_maximumValue);
+
+    // A zero-length segment draws nothing
+    auto collapse = [&](int slot) {
+        vertices[2 * slot].set(slot * xStep, h);
+        vertices[2 * slot + 1].set(slot * xStep, h);
+    };
+
+    qint64 from = m_rebuild ? cursor - points : qMax(m_renderedCursor, cursor - points);
+    if (m_rebuild) {
+        for (int slot = 0; slot < points; ++slot)
+            collapse(slot);
+    }
+
+    if (m_buffer && cursor > 0) {
+        from = qMax(from, m_buffer->firstIndex());
+
+        // Read one sample in front of the new range so the first segment has a start point
+        const qint64 readFrom = qMax(from - 1, m_buffer->firstIndex());
+        m_scratch.resize(int(cursor - readFrom));
+        m_buffer->read(readFrom, m_scratch.data(), m_scratch.size());
+        const int offset = int(from - readFrom);
+
+        for (qint64 index = from; index < cursor; ++index) {
+            const int k = offset + int(index - from);
+            const int slot = int(index % points);
+            const float x = slot * xStep;
+            const float y = h - m_scratch[k] * yScale;
+
+            if (slot == 0 || k == 0) {
+                // Start of a sweep (or of the readable history): nothing to join to
+                vertices[2 * slot].set(x, y);
+            } else {
+                vertices[2 * slot].set(x - xStep, h - m_scratch[k - 1] * yScale);
+            }
+            vertices[2 * slot + 1].set(x, y);
+        }
+    }
+
+    // Erase bar ahead of the pen
+    const int erase = qMin(m_eraseSamples, points - 1);
+    for (int i = 0; i < erase; ++i)
+        collapse(int((cursor + i) % points));
+
+    m_renderedCursor = cursor;
+    m_rebuild = false;
+    node->markDirty(QSGNode::DirtyGeometry);
+    return node;
+}
@@ -0,0 +1,81 @@
+#ifndef WAVEFORMTRACE_H
+#define WAVEFORMTRACE_H
+
+#include <QQuickItem>
+#include <QPointer>
+#include <QColor>
+#include <QVector>
+#include "waveformbuffer.h"
+
+class QSGGeometryNode;
+
+// Scene-graph trace renderer for a WaveformBuffer, drawn like a bedside
+// monitor sweep: the pen moves left to right, wraps around, and a short
+// erase bar runs ahead of it. Each frame only the vertices for samples
+// written since the previous frame (and the erase bar) are rewritten.
+// Repaints go through QQuickItem::update(), so at most one geometry update
+// happens per displayed frame however fast samples arrive.
+class WaveformTraceItem : public QQuickItem
+{
+    Q_OBJECT
+    QML_NAMED_ELEMENT(WaveformTrace)
+
+    Q_PROPERTY(WaveformBuffer* buffer READ buffer WRITE setBuffer NOTIFY bufferChanged)
+    Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
+    Q_PROPERTY(qreal lineWidth READ lineWidth WRITE setLineWidth NOTIFY lineWidthChanged)
+    Q_PROPERTY(int visibleSamples READ visibleSamples WRITE setVisibleSamples NOTIFY visibleSamplesChanged)
+    Q_PROPERTY(int eraseSamples READ eraseSamples WRITE setEraseSamples NOTIFY eraseSamplesChanged)
+    Q_PROPERTY(int maximumValue READ maximumValue WRITE setMaximumValue NOTIFY maximumValueChanged)
+
+public:
+    explicit WaveformTraceItem(QQuickItem *parent = nullptr);
+
+    WaveformBuffer *buffer() const { return m_buffer; }
+    void setBuffer(WaveformBuffer *buffer);
+
+    QColor color() const { return m_color; }
+    void setColor(const QColor &color);
+
+    qreal lineWidth() const { return m_lineWidth; }
+    void setLineWidth(qreal width);
+
+    int visibleSamples() const { return m_visibleSamples; }
+    void setVisibleSamples(int samples);
+
+    int eraseSamples() const { return m_eraseSamples; }
+    void setEraseSamples(int samples);
+
+    int maximumValue() const { return m_maximumValue; }
+    void setMaximumValue(int value);
+
+signals:
+
+    void bufferChanged();
+    void colorChanged();
+    void lineWidthChanged();
+    void visibleSamplesChanged();
+    void eraseSamplesChanged();
+    void maximumValueChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+private:
+    void requestRebuild();
+
+    QPointer<WaveformBuffer> m_buffer;
+    QColor m_color = QColor("#4CAF50");
+    qreal m_lineWidth = 2;
+    int m_visibleSamples = 200;
+    int m_eraseSamples = 10;
+    int m_maximumValue = 255;
+
+    // Render state, only touched while the scene graph synchronises
+    bool m_rebuild = true;
+    bool m_materialDirty = true;
+    qint64 m_renderedCursor = 0;
+    QVector<WaveformBuffer::Sample> m_scratch;
+};
+
+#endif // WAVEFORMTRACE_H